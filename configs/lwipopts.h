@@ -206,7 +206,7 @@
 /**
  * MEMP_NUM_SYS_TIMEOUT: the number of simultaneously active timeouts.
  */
-#define MEMP_NUM_SYS_TIMEOUT            12
+#define MEMP_NUM_SYS_TIMEOUT            18
 
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool.
@@ -271,6 +271,7 @@
 #define LWIP_NETIF_STATUS_CALLBACK    (1)
 #define LWIP_NETIF_LINK_CALLBACK      (1)
 #define LWIP_NETIF_REMOVE_CALLBACK    (1)
+#define LWIP_NETIF_EXT_STATUS_CALLBACK (1)
 
 #define LWIP_CHKSUM_ALGORITHM         (3)
 
@@ -33,6 +33,7 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "lwipopts.h"
 #include "lwip/netif.h"
 #include "lwip/netifapi.h"
@@ -43,10 +44,22 @@
 #include "lwip/ethip6.h"
 #include "lwip/igmp.h"
 #include "lwip/nd6.h"
+#if LWIP_IPV6
+#include "lwip/ip6.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/icmp6.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/prot/nd6.h"
+#endif
 #include "netif/ethernet.h"
 #include "lwip/prot/autoip.h"
 #include "lwip/prot/dhcp.h"
+#include "lwip/prot/etharp.h"
+#include "lwip/prot/iana.h"
 #include "lwip/dns.h"
+#if LWIP_TCP
+#include "lwip/priv/tcp_priv.h"
+#endif
 
 #include "cybsp_wifi.h"
 #include "cy_network_buffer.h"
@@ -87,15 +100,398 @@ int errno;
 #define AUTO_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS (60000 * 10)
 #endif
 #define DCHP_RENEWAL_DELAY_IN_MS                 (100)
+#define DHCP_RENEW_POLL_INTERVAL_MS              (50)
+#define AUTO_IP_BOUND_POLL_INTERVAL_MS           (100)
+
+/* Time given to the DHCP server to acknowledge the lease, see cy_lwip_dhcp_renew_async() */
+#ifndef CY_LWIP_DHCP_RENEW_TIMEOUT_MS
+#define CY_LWIP_DHCP_RENEW_TIMEOUT_MS            (10000)
+#endif
+
+/* Time given to the peers to answer the unicast ARP probes of a DHCP renewal */
+#ifndef CY_LWIP_ARP_REVALIDATE_TIMEOUT_MS
+#define CY_LWIP_ARP_REVALIDATE_TIMEOUT_MS        (500)
+#endif
 #define DHCP_STOP_DELAY_IN_MS                    (400)
 
-#define MAX_NW_INTERFACE                         (2)
+/*
+ * Maximum number of network interfaces which can be added at the same time. WHD interface
+ * indexes are used to look up the network interface of a received packet, so this must be
+ * larger than the highest WHD interface index in use.
+ */
+#ifndef CY_LWIP_MAX_NW_INTERFACE
+#define CY_LWIP_MAX_NW_INTERFACE                 (4)
+#endif
+
+/* Number of network interface roles, see cy_lwip_nw_interface_role_t */
+#define NW_INTERFACE_ROLE_COUNT                  (CY_LWIP_AP_NW_INTERFACE + 1)
 
-struct  netif                                    *cy_lwip_ip_handle[MAX_NW_INTERFACE];
-#define IP_HANDLE(interface)                     (cy_lwip_ip_handle[(interface) & 3])
+/* States of an asynchronous network bring-up */
+#define NW_UP_STATE_IDLE                         (0)
+#define NW_UP_STATE_WAIT_DHCP                    (1)
+#define NW_UP_STATE_WAIT_AUTOIP                  (2)
 
 #define MAX_AUTO_IP_RETRIES                      (5)
 
+/*
+ * Number of DHCP leases of STA interfaces cached to reconnect with an INIT-REBOOT
+ * DHCPREQUEST instead of a full DHCPDISCOVER exchange. The cache is disabled by default
+ * as it changes how STA interfaces reconnect; 0 disables it.
+ */
+#ifndef CY_LWIP_DHCP_LEASE_CACHE_SIZE
+#define CY_LWIP_DHCP_LEASE_CACHE_SIZE            (0)
+#endif
+
+#define DHCP_LEASE_CACHE                         (LWIP_IPV4 && (CY_LWIP_DHCP_LEASE_CACHE_SIZE > 0))
+
+/* The INIT-REBOOT of a cached lease sets DHCP client state LwIP keeps private, as LwIP 2.1 does */
+#if DHCP_LEASE_CACHE && ((LWIP_VERSION_MAJOR != 2) || (LWIP_VERSION_MINOR != 1))
+#error "CY_LWIP_DHCP_LEASE_CACHE_SIZE relies on the DHCP client of LwIP 2.1, check dhcp_lease_reboot() against this LwIP version"
+#endif
+
+/*
+ * When enabled, IPv6 addresses are made usable as soon as they are assigned, as optimistic
+ * addresses (RFC 4429) are, instead of after duplicate address detection. The port keeps
+ * probing them in the background and reports a conflict through the IP change callback.
+ * While an address is probed, the port applies the neighbor discovery restrictions of
+ * RFC 4429 which LwIP does not know about: a probe of another node for the address makes
+ * it a duplicate instead of being answered, advertisements for the address do not set the
+ * Override flag, and solicitations from the address carry no source link-layer address.
+ */
+#ifndef CY_LWIP_IPV6_OPTIMISTIC_DAD
+#define CY_LWIP_IPV6_OPTIMISTIC_DAD              (0)
+#endif
+
+#define OPTIMISTIC_DAD                           (LWIP_IPV6 && CY_LWIP_IPV6_OPTIMISTIC_DAD && (LWIP_IPV6_DUP_DETECT_ATTEMPTS > 0))
+
+/* Interval between two duplicate address detection probes, RetransTimer of RFC 4861 */
+#define OPTIMISTIC_DAD_PROBE_INTERVAL_MS         (1000)
+
+/* Hop limit of neighbor discovery messages, RFC 4861 */
+#define ND6_MESSAGE_HOP_LIMIT                    (255)
+
+/* Offset of the ICMPv6 header in an ethernet frame carrying an IPv6 packet without extension headers */
+#define ND6_FRAME_ICMP6_OFFSET                   (ETHERNET_HEADER_LENGTH + IP6_HLEN)
+
+/*
+ * When enabled, the time spent in each phase of cy_lwip_network_up() and cy_lwip_network_down()
+ * is recorded, and the CY_LWIP_PHASE_TIMING_RECORDS most recent records are returned by
+ * cy_lwip_get_phase_timing(). Compiled out, the PHASE_BEGIN()/PHASE_END() marks cost nothing.
+ */
+#ifndef CY_LWIP_PHASE_TIMING
+#define CY_LWIP_PHASE_TIMING                     (0)
+#endif
+
+#ifndef CY_LWIP_PHASE_TIMING_RECORDS
+#define CY_LWIP_PHASE_TIMING_RECORDS             (8)
+#endif
+
+/*
+ * When enabled, the neighbors learn a new address, and the interface learns the gateway,
+ * without waiting for the first packet: an IPv6 address is announced with an unsolicited
+ * neighbor advertisement once it is valid, and the MAC address of the gateway, taken from
+ * the DHCP reply it sent, is installed as a static ARP entry once DHCP binds. LwIP already
+ * sends a gratuitous ARP whenever the IPv4 address changes or the link comes up.
+ */
+#ifndef CY_LWIP_ANNOUNCE_ON_BIND
+#define CY_LWIP_ANNOUNCE_ON_BIND                 (0)
+#endif
+
+#define GATEWAY_ARP_PRESEED                      (CY_LWIP_ANNOUNCE_ON_BIND && LWIP_IPV4 && LWIP_ARP && ETHARP_SUPPORT_STATIC_ENTRIES)
+#define IPV6_ANNOUNCE                            (CY_LWIP_ANNOUNCE_ON_BIND && LWIP_IPV6)
+
+#if CY_LWIP_PHASE_TIMING
+#define PHASE_BEGIN(record, phase)               phase_timing_mark((record), (phase), true)
+#define PHASE_END(record, phase)                 phase_timing_mark((record), (phase), false)
+#else
+#define PHASE_BEGIN(record, phase)
+#define PHASE_END(record, phase)
+#endif
+
+/*
+ * When enabled, wifioutput() hands the pbuf received from LwIP to WHD by reference
+ * instead of duplicating it. A copy is still made when the pbuf is chained, does not
+ * own its payload (PBUF_ROM/PBUF_REF) or lacks headroom for the WHD bus header.
+ */
+#ifndef CY_LWIP_TX_ZERO_COPY
+#define CY_LWIP_TX_ZERO_COPY                     (1)
+#endif
+
+/* Headroom WHD needs in front of the ethernet header to prepend its bus header */
+#define CY_LWIP_TX_HEADROOM                      (PBUF_LINK_HLEN - SIZEOF_ETH_HDR)
+
+/*
+ * When enabled, wifioutput() classifies outgoing packets into the four WMM access categories
+ * from their DSCP and queues them in the port layer. At most CY_LWIP_TX_SCHED_MAX_IN_FLIGHT
+ * packets are handed to WHD at a time, so higher priority packets overtake the packets still
+ * waiting in the lower priority queues. Packets are queued by reference as with
+ * CY_LWIP_TX_ZERO_COPY, and the release of a packet by WHD is seen from its reference count.
+ */
+#ifndef CY_LWIP_TX_SCHEDULER
+#define CY_LWIP_TX_SCHEDULER                     (0)
+#endif
+
+/* Maximum number of packets handed to WHD and not yet released by it */
+#ifndef CY_LWIP_TX_SCHED_MAX_IN_FLIGHT
+#define CY_LWIP_TX_SCHED_MAX_IN_FLIGHT           (4)
+#endif
+
+/* Capacity of each access category queue; the depth limit of a queue cannot exceed it */
+#ifndef CY_LWIP_TX_SCHED_QUEUE_SIZE
+#define CY_LWIP_TX_SCHED_QUEUE_SIZE              (16)
+#endif
+
+/* Interval at which the packets handed to WHD are checked for release while some are in flight */
+#ifndef CY_LWIP_TX_SCHED_POLL_INTERVAL_MS
+#define CY_LWIP_TX_SCHED_POLL_INTERVAL_MS        (1)
+#endif
+
+/* Number of bytes of an ethernet frame needed to read the IPv4 ToS or IPv6 traffic class */
+#define TX_SCHED_CLASSIFY_LENGTH                 (ETHERNET_HEADER_LENGTH + 2)
+
+/*
+ * Number of outgoing packets parked while WHD is not ready to transmit, for instance during
+ * rekeying, roaming or power-save wake, or while no buffer can be allocated for WHD. Parked
+ * packets are sent as soon as WHD is ready again. Set to 0 to drop such packets instead.
+ */
+#ifndef CY_LWIP_TX_HOLD_QUEUE_SIZE
+#define CY_LWIP_TX_HOLD_QUEUE_SIZE               (8)
+#endif
+
+/* Maximum time a packet stays parked in the hold queue before it is dropped */
+#ifndef CY_LWIP_TX_HOLD_MAX_AGE_MS
+#define CY_LWIP_TX_HOLD_MAX_AGE_MS               (500)
+#endif
+
+/* Interval at which parked packets are retried */
+#ifndef CY_LWIP_TX_HOLD_POLL_INTERVAL_MS
+#define CY_LWIP_TX_HOLD_POLL_INTERVAL_MS         (10)
+#endif
+
+/* Maximum number of packets delivered to LwIP under a single TCP/IP core lock acquisition */
+#ifndef CY_LWIP_RX_BATCH_MAX
+#define CY_LWIP_RX_BATCH_MAX                     (16)
+#endif
+
+/* Maximum time the TCP/IP core lock is held while delivering a batch of received packets */
+#ifndef CY_LWIP_RX_BATCH_TIME_BUDGET_MS
+#define CY_LWIP_RX_BATCH_TIME_BUDGET_MS          (5)
+#endif
+
+/*
+ * Minimum interval between two invocations of the network activity callback for the same
+ * activity type; notifications in between are dropped. It must be shorter than the network
+ * inactivity window configured in the Low Power Assistant, so that the network stack cannot
+ * be suspended while notifications are being dropped. Set to 0 to notify every packet.
+ */
+#ifndef CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS
+#define CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS        (10)
+#endif
+
+/* Maximum number of callbacks subscribed with cy_lwip_ip_change_subscribe() */
+#ifndef CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS
+#define CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS        (4)
+#endif
+
+/* Number of slots in the ethertype handler table, must be a power of two */
+#ifndef CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE
+#define CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE     (8)
+#endif
+
+#define ETHERTYPE_HANDLER_TABLE_MASK             (CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE - 1)
+#define ETHERTYPE_HANDLER_HASH(ethertype, role)  ((uint32_t)((ethertype) ^ ((ethertype) >> 7) ^ ((uint32_t)(role) * 5)) & ETHERTYPE_HANDLER_TABLE_MASK)
+
+#define ETHERTYPE_HANDLER_SLOT_EMPTY             (0)
+#define ETHERTYPE_HANDLER_SLOT_USED              (1)
+#define ETHERTYPE_HANDLER_SLOT_DELETED           (2)
+
+/* Maximum number of RX filter rules per interface role */
+#ifndef CY_LWIP_RX_FILTER_MAX_RULES
+#define CY_LWIP_RX_FILTER_MAX_RULES              (8)
+#endif
+
+/*
+ * Number of slots in the compiled RX filter table of an interface role, must be a power of two.
+ * Each rule takes one slot per destination MAC class it matches.
+ */
+#ifndef CY_LWIP_RX_FILTER_TABLE_SIZE
+#define CY_LWIP_RX_FILTER_TABLE_SIZE             (32)
+#endif
+
+#define RX_FILTER_TABLE_MASK                     (CY_LWIP_RX_FILTER_TABLE_SIZE - 1)
+#define RX_FILTER_NO_RULE                        (0xFF)
+#define RX_FILTER_MAC_CLASS_COUNT                (3)
+#define RX_FILTER_MAX_FIELD_MASKS                (8)
+
+/* Packet fields a compiled RX filter slot matches on, besides the destination MAC class */
+#define RX_FILTER_FIELD_ETHERTYPE                (0x01)
+#define RX_FILTER_FIELD_PROTOCOL                 (0x02)
+#define RX_FILTER_FIELD_PORT                     (0x04)
+
+#define RX_FILTER_HASH(key, ethertype, protocol, port)  ((uint32_t)(((key) * 101u) ^ ((ethertype) * 31u) ^ ((protocol) * 13u) ^ ((port) * 7u) ^ ((port) >> 5)) & RX_FILTER_TABLE_MASK)
+
+#define IP_PROTOCOL_TCP                          (6)
+#define IP_PROTOCOL_UDP                          (17)
+#define ETHERNET_HEADER_LENGTH                   (14)
+#define IPV4_MIN_HEADER_LENGTH                   (20)
+#define IPV6_HEADER_LENGTH                       (40)
+#define DHCP_SERVER_UDP_PORT                     (67)
+#define DHCP_CLIENT_UDP_PORT                     (68)
+
+#if (CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE & ETHERTYPE_HANDLER_TABLE_MASK) != 0
+#error "CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE must be a power of two"
+#endif
+
+/* Slot of the open-addressed ethertype handler table */
+typedef struct
+{
+    cy_lwip_ethertype_handler_t handler;   /* Handler invoked for matching packets */
+    void                        *arg;      /* User argument passed to the handler  */
+    uint16_t                    ethertype; /* Ethertype in host byte order         */
+    uint8_t                     role;      /* Network interface role               */
+    volatile uint8_t            state;     /* ETHERTYPE_HANDLER_SLOT_xxx           */
+} ethertype_handler_entry_t;
+
+/* Callback subscribed with cy_lwip_ip_change_subscribe() */
+typedef struct
+{
+    cy_lwip_ip_change_event_callback_t callback;  /* NULL if the slot is free          */
+    void                               *arg;      /* User argument passed to callback  */
+} ip_change_subscriber_t;
+
+#if CY_LWIP_TX_SCHEDULER
+/* Packet queued in an access category queue */
+typedef struct
+{
+    whd_interface_t whd_iface;  /* WHD interface the packet is sent on */
+    struct pbuf     *p;         /* Packet, referenced or copied        */
+} tx_sched_entry_t;
+
+/* Access category queue, a ring of packets waiting to be handed to WHD */
+typedef struct
+{
+    tx_sched_entry_t         ring[CY_LWIP_TX_SCHED_QUEUE_SIZE];
+    uint16_t                 head;         /* Index of the oldest packet             */
+    uint16_t                 count;        /* Number of packets in the ring          */
+    uint16_t                 depth_limit;  /* Maximum number of packets queued       */
+    uint8_t                  weight;       /* Packets per round in weighted mode     */
+    uint8_t                  credit;       /* Packets left in the current round      */
+    cy_lwip_tx_sched_stats_t stats;
+} tx_sched_queue_t;
+
+/*
+ * Packet handed to WHD by the TX scheduler. WHD gets a reference of its own, and the
+ * reference taken when the packet was queued is kept until WHD drops its reference,
+ * which brings the reference count of the packet back to what it was before.
+ */
+typedef struct
+{
+    struct pbuf *p;    /* NULL if the slot is free                     */
+    u8_t        ref;   /* Reference count once WHD released the packet */
+} tx_sched_in_flight_t;
+#endif /* CY_LWIP_TX_SCHEDULER */
+
+/*
+ * Network interface added to LwIP. Entries are allocated when an interface is first added
+ * and recycled once it is removed, so that a packet still being received on a removed
+ * interface never refers to freed memory.
+ */
+typedef struct nw_interface_entry
+{
+    struct netif                netif;                    /* LwIP network interface               */
+    whd_interface_t             whd_iface;                /* WHD interface, NULL if free          */
+    cy_lwip_nw_interface_role_t role;                     /* Network interface role               */
+    bool                        is_up;                    /* Network brought up                   */
+    bool                        is_dhcp_client_required;  /* No static IP address, STA role only  */
+    uint8_t                     up_state;                 /* NW_UP_STATE_xxx, IPv4 acquisition    */
+    uint8_t                     up_wait;                  /* Families awaited, 0 if not bringing up */
+    uint8_t                     autoip_tries;             /* AutoIP timeouts during bring-up      */
+    cy_lwip_nw_interface_t      up_iface;                 /* Interface passed to up_params        */
+    cy_lwip_network_up_params_t up_params;                /* Parameters of the bring-up           */
+#if LWIP_IPV4
+    cy_lwip_dhcp_server_t       dhcp_server;              /* Internal DHCP server, AP role only   */
+    cy_lwip_dhcp_server_config_t dhcp_server_config;      /* Configuration of the DHCP server     */
+#endif
+#if DHCP_LEASE_CACHE
+    cy_lwip_dhcp_lease_t        lease_key;                /* Network joined, ssid_len 0 if unknown */
+#endif
+#if OPTIMISTIC_DAD
+    uint8_t                     dad_probes[LWIP_IPV6_NUM_ADDRESSES]; /* DAD probes left per optimistic address */
+    uint8_t                     dad_conflicts;            /* Optimistic addresses probed by another node, bit per index */
+#endif
+#if CY_LWIP_PHASE_TIMING
+    cy_lwip_phase_record_t      up_timing;                /* Timing record of the bring-up        */
+#endif
+#if LWIP_IPV4
+    bool                        renew_in_progress;        /* DHCP renewal in progress             */
+    bool                        renew_wait_dhcp;          /* Renewal waits for the DHCP ACK       */
+    uint32_t                    renew_start;              /* sys_now() at the start of renewal    */
+    cy_lwip_nw_interface_t      renew_iface;              /* Interface passed to the renewal      */
+    cy_lwip_dhcp_renew_params_t renew_params;             /* Parameters of the renewal            */
+    volatile bool               arp_probing;              /* Unicast ARP probes are outstanding   */
+    volatile uint8_t            arp_probe_count;          /* Number of peers probed               */
+    volatile ip4_addr_t         arp_probe_addr[ARP_TABLE_SIZE];      /* Addresses of the peers probed */
+    volatile bool               arp_probe_answered[ARP_TABLE_SIZE];  /* Peer answered its probe       */
+#endif
+#if GATEWAY_ARP_PRESEED
+    struct eth_addr             dhcp_server_hwaddr;       /* Source MAC of the last DHCP reply    */
+    uint32_t                    dhcp_server_ip;           /* Source IPv4 address of that reply    */
+    ip4_addr_t                  preseeded_gw;             /* Gateway with a static ARP entry      */
+#endif
+    struct nw_interface_entry   *next;                    /* Next entry, in order of addition     */
+} nw_interface_entry_t;
+
+/* Wait context of cy_lwip_network_up() */
+typedef struct
+{
+    cy_semaphore_t sem;     /* Signaled once the bring-up completes */
+    cy_rslt_t      result;  /* Result of the bring-up               */
+} nw_up_sync_t;
+
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+/* Packet parked in the TX hold queue */
+typedef struct
+{
+    whd_interface_t whd_iface;  /* WHD interface the packet is sent on   */
+    struct pbuf     *p;         /* Packet, referenced or copied          */
+    uint32_t        time;       /* Time the packet was parked, sys_now() */
+} tx_hold_entry_t;
+#endif
+
+#if (CY_LWIP_RX_FILTER_TABLE_SIZE & RX_FILTER_TABLE_MASK) != 0
+#error "CY_LWIP_RX_FILTER_TABLE_SIZE must be a power of two"
+#endif
+
+#if (CY_LWIP_RX_FILTER_TABLE_SIZE <= (CY_LWIP_RX_FILTER_MAX_RULES * RX_FILTER_MAC_CLASS_COUNT)) || (CY_LWIP_RX_FILTER_MAX_RULES >= RX_FILTER_NO_RULE)
+#error "CY_LWIP_RX_FILTER_TABLE_SIZE is too small for CY_LWIP_RX_FILTER_MAX_RULES"
+#endif
+
+/* Slot of a compiled RX filter table */
+typedef struct
+{
+    uint16_t ethertype;  /* Ethertype to match, 0 if not matched         */
+    uint16_t port;       /* Destination port to match, 0 if not matched  */
+    uint8_t  protocol;   /* IP protocol to match, 0 if not matched       */
+    uint8_t  key;        /* RX_FILTER_FIELD_xxx mask | MAC class << 4    */
+    uint8_t  rule;       /* Index of the rule, RX_FILTER_NO_RULE if free */
+    uint8_t  action;     /* cy_lwip_rx_filter_action_t of the rule       */
+} rx_filter_slot_t;
+
+/*
+ * RX filter of an interface role. Rules are compiled into a hash table holding one
+ * slot per (rule, MAC class) pair, keyed by the fields the rule matches on. A packet
+ * is evaluated with one probe per distinct field mask in use and the lowest matching
+ * rule index wins, which preserves first-match semantics.
+ */
+typedef struct
+{
+    uint8_t          field_mask_count;
+    uint8_t          field_masks[RX_FILTER_MAX_FIELD_MASKS];
+    rx_filter_slot_t table[CY_LWIP_RX_FILTER_TABLE_SIZE];
+    uint32_t         hits[CY_LWIP_RX_FILTER_MAX_RULES];
+    volatile uint8_t users;      /* Number of RX threads evaluating the table */
+} rx_filter_t;
+
 #ifdef COMPONENT_43907
 #define CY_PRNG_SEED_FEEDBACK_MAX_LOOPS          (1000)
 #define CY_PRNG_CRC32_POLYNOMIAL                 (0xEDB88320)
@@ -106,30 +502,67 @@ struct  netif                                    *cy_lwip_ip_handle[MAX_NW_INTER
  *               Variable Definitions
  ******************************************************/
 static cy_network_activity_event_callback_t activity_callback = NULL;
-static bool is_dhcp_client_required = false;
+#if CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS > 0
+static uint32_t activity_notify_time[CY_NETWORK_ACTIVITY_RX + 1];
+static bool     activity_notified[CY_NETWORK_ACTIVITY_RX + 1];
+#endif
 static cy_wifimwcore_eapol_packet_handler_t internal_eapol_packet_handler = NULL;
 static cy_lwip_ip_change_callback_t ip_change_callback = NULL;
-
-#if LWIP_IPV4
-static cy_lwip_dhcp_server_t internal_dhcp_server;
+static ip_change_subscriber_t ip_change_subscribers[CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS];
+static ethertype_handler_entry_t ethertype_handlers[CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE];
+static uint8_t ethertype_handler_count = 0;
+/*
+ * Each role has two RX filter tables, shared by all the interfaces of the role: the rules are
+ * compiled into the one that is not published in rx_filters, once no RX thread evaluates it
+ * any more, and then published. rx_filter_mutex serializes the writers.
+ */
+static rx_filter_t rx_filter_tables[NW_INTERFACE_ROLE_COUNT][2];
+static rx_filter_t * volatile rx_filters[NW_INTERFACE_ROLE_COUNT];       /* NULL if the role has no rules */
+static cy_mutex_t  rx_filter_mutex;
+static cy_mutex_t  *rx_filter_mutex_ptr;
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+/* Hold queue, oldest packet first. Only accessed with the TCP/IP core lock held */
+static tx_hold_entry_t tx_hold_queue[CY_LWIP_TX_HOLD_QUEUE_SIZE];
+static uint32_t tx_hold_count = 0;
 #endif
-
-static struct netif       sta_ip_handle;
-static struct netif       ap_ip_handle;
-
-struct netif* cy_lwip_ip_handle[MAX_NW_INTERFACE] =
+#if CY_LWIP_TX_SCHEDULER
+/* Queues and in-flight packets are only accessed with the TCP/IP core lock held */
+static tx_sched_queue_t tx_sched_queues[CY_LWIP_TX_AC_MAX] =
 {
-    [CY_LWIP_STA_NW_INTERFACE] =  &sta_ip_handle,
-    [CY_LWIP_AP_NW_INTERFACE]  =  &ap_ip_handle
+    [CY_LWIP_TX_AC_BE] = { .depth_limit = CY_LWIP_TX_SCHED_QUEUE_SIZE, .weight = 2 },
+    [CY_LWIP_TX_AC_BK] = { .depth_limit = CY_LWIP_TX_SCHED_QUEUE_SIZE, .weight = 1 },
+    [CY_LWIP_TX_AC_VI] = { .depth_limit = CY_LWIP_TX_SCHED_QUEUE_SIZE, .weight = 4 },
+    [CY_LWIP_TX_AC_VO] = { .depth_limit = CY_LWIP_TX_SCHED_QUEUE_SIZE, .weight = 8 }
 };
+static cy_lwip_tx_sched_mode_t tx_sched_mode = CY_LWIP_TX_SCHED_MODE_WEIGHTED;
+static tx_sched_in_flight_t tx_sched_in_flight[CY_LWIP_TX_SCHED_MAX_IN_FLIGHT];
+static uint32_t tx_sched_in_flight_count = 0;
+#endif
 
-/* Interface init status */
-bool ip_networking_inited[MAX_NW_INTERFACE];
-#define SET_IP_NETWORK_INITED(interface, status)   (ip_networking_inited[(interface)&3] = status)
+/* Interfaces added to LwIP, in order of addition, and entries of removed interfaces */
+static nw_interface_entry_t *nw_interface_list = NULL;
+static nw_interface_entry_t *nw_interface_free_list = NULL;
 
-/* IP UP status */
-bool ip_up[MAX_NW_INTERFACE];
-#define SET_IP_UP(interface, status)               (ip_up[(interface)&3] = status)
+/* Interfaces added to LwIP, indexed by WHD interface index */
+static nw_interface_entry_t *volatile nw_interface_lookup[CY_LWIP_MAX_NW_INTERFACE];
+
+/* LwIP interface events, reported to the IP change callbacks and driving the asynchronous network bring-ups */
+NETIF_DECLARE_EXT_CALLBACK(nw_interface_netif_ext_callback)
+static bool nw_interface_ext_callback_registered = false;
+
+#if CY_LWIP_PHASE_TIMING
+/* Timing records of the most recent bring-ups and tear downs, oldest at phase_timing_next once full */
+static cy_lwip_phase_record_t phase_timing_records[CY_LWIP_PHASE_TIMING_RECORDS];
+static uint32_t phase_timing_next = 0;
+static uint32_t phase_timing_count = 0;
+#endif
+
+#if DHCP_LEASE_CACHE
+/* DHCP leases of STA interfaces, most recently used first */
+static cy_lwip_dhcp_lease_t dhcp_lease_cache[CY_LWIP_DHCP_LEASE_CACHE_SIZE];
+static uint32_t dhcp_lease_count = 0;
+static cy_lwip_dhcp_lease_cache_config_t dhcp_lease_config;
+#endif
 
 #ifdef COMPONENT_43907
 static uint32_t prng_well512_state[ CY_PRNG_WELL512_STATE_SIZE ];
@@ -145,13 +578,42 @@ static cy_mutex_t *cy_prng_mutex_ptr;
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
-static void internal_ip_change_callback (struct netif *netif);
+static void nw_interface_ext_callback(struct netif *netif, netif_nsc_reason_t reason, const netif_ext_callback_args_t *args);
+static void ip_change_notify(nw_interface_entry_t *nw_interface, netif_nsc_reason_t reason, const netif_ext_callback_args_t *args);
+static void internal_network_activity_notify(cy_network_activity_type_t activity_type);
 #if LWIP_IPV4
 static void invalidate_all_arp_entries(struct netif *netif);
+static void arp_revalidate_capture(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length);
+static void dhcp_renew_complete(nw_interface_entry_t *nw_interface, cy_rslt_t result);
+static void dhcp_renew_timer(void *arg);
 #endif
-static bool is_interface_added(cy_lwip_nw_interface_role_t role);
+static nw_interface_entry_t *find_nw_interface(whd_interface_t whd_iface);
+static nw_interface_entry_t *get_nw_interface(cy_lwip_nw_interface_t *iface);
 static cy_rslt_t is_interface_valid(cy_lwip_nw_interface_t *iface);
-static bool is_network_up(cy_lwip_nw_interface_role_t role);
+static void nw_up_timeout(void *arg);
+#if LWIP_IPV4 && LWIP_AUTOIP
+static void nw_up_autoip_poll(void *arg);
+#endif
+static ethertype_handler_entry_t *find_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role);
+static void eapol_ethertype_handler(whd_interface_t iface, whd_buffer_t buf, void *arg);
+static bool rx_filter_drop_packet(rx_filter_t *filter, const uint8_t *data, uint16_t length);
+#if GATEWAY_ARP_PRESEED
+static void gateway_arp_capture(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length);
+#endif
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+static err_t tx_hold_enqueue(whd_interface_t whd_iface, struct pbuf *p);
+static void tx_hold_poll(void *arg);
+static void tx_hold_discard(whd_interface_t whd_iface);
+#endif
+#if OPTIMISTIC_DAD
+static bool optimistic_dad_rx_conflict(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length);
+static void optimistic_dad_tx_restrict(whd_interface_t whd_iface, struct pbuf *p);
+#endif
+#if CY_LWIP_TX_SCHEDULER
+static void tx_sched_drain(void);
+static void tx_sched_poll(void *arg);
+static void tx_sched_flush(whd_interface_t whd_iface);
+#endif
 
 #ifdef COMPONENT_43907
 static uint32_t prng_well512_get_random ( void );
@@ -163,864 +625,3810 @@ cy_rslt_t cy_prng_add_entropy( const void* buffer, uint32_t buffer_length );
  *               Function Definitions
  ******************************************************/
 /*
- * This function takes packets from the radio driver and passes them into the
- * LwIP stack.  If the stack is not initialized, or if the LwIP stack does not
- * accept the packet, the packet is freed (dropped). If packet is of type EAPOL
- * and if EAPOL handler is registered, packet will be redirected to registered
- * handler and should be freed by EAPOL handler.
+ * This function classifies a packet received from the radio driver. It returns the
+ * LwIP network interface the packet has to be delivered to, or NULL if the packet was
+ * consumed here. If a handler is registered for the ethertype of the packet on the
+ * receiving interface, packet will be redirected to registered handler and should be
+ * freed by that handler. EAPOL packets never reach LwIP.
  */
-void cy_network_process_ethernet_data(whd_interface_t iface, whd_buffer_t buf)
+static struct netif *rx_classify_packet(whd_interface_t iface, whd_buffer_t buf)
 {
     uint8_t *data = whd_buffer_get_current_piece_data_pointer(iface->whd_driver, buf);
     uint16_t ethertype;
-    struct netif *net_interface = NULL;
+    nw_interface_entry_t *nw_interface = find_nw_interface(iface);
+    cy_lwip_nw_interface_role_t role;
 
-    if(iface->role == WHD_STA_ROLE)
-    {
-        net_interface = &sta_ip_handle;
-    }
-    else if(iface->role == WHD_AP_ROLE)
-    {
-        net_interface = &ap_ip_handle;
-    }
-    else
+    if(nw_interface == NULL)
     {
         cy_buffer_release(buf, WHD_NETWORK_RX) ;
-        return;
+        return NULL;
     }
+    role = nw_interface->role;
 
     ethertype = (uint16_t)(data[12] << 8 | data[13]);
-    if (ethertype == EAPOL_PACKET_TYPE)
+    if (ethertype_handler_count != 0)
     {
-        if( internal_eapol_packet_handler != NULL )
+        ethertype_handler_entry_t *entry;
+        cy_lwip_ethertype_handler_t handler = NULL;
+        void *arg = NULL;
+        SYS_ARCH_DECL_PROTECT(lev);
+
+        /* Handler and argument are read together, so that a concurrent (un)registration never mixes them */
+        SYS_ARCH_PROTECT(lev);
+        entry = find_ethertype_handler(ethertype, role);
+        if (entry != NULL)
         {
-            internal_eapol_packet_handler(iface, buf);
+            handler = entry->handler;
+            arg     = entry->arg;
         }
-        else
+        SYS_ARCH_UNPROTECT(lev);
+
+        if (handler != NULL)
         {
-            cy_buffer_release(buf, WHD_NETWORK_RX) ;
+            handler(iface, buf, arg);
+            return NULL;
         }
     }
-    else
+
+    if (ethertype == EAPOL_PACKET_TYPE)
     {
-        /* Call activity handler which is registered with argument as false
-         * indicating there is RX packet
-         */
-        if (activity_callback)
+        /* No EAPOL handler registered, drop the packet */
+        cy_buffer_release(buf, WHD_NETWORK_RX) ;
+        return NULL;
+    }
+
+    if (rx_filters[role] != NULL)
+    {
+        rx_filter_t *filter;
+        bool drop = false;
+        SYS_ARCH_DECL_PROTECT(lev);
+
+        /* Taking the table and counting this thread as a user is atomic with respect to cy_lwip_rx_filter_set_rules() */
+        SYS_ARCH_PROTECT(lev);
+        filter = rx_filters[role];
+        if (filter != NULL)
+        {
+            filter->users++;
+        }
+        SYS_ARCH_UNPROTECT(lev);
+
+        if (filter != NULL)
         {
-            activity_callback(false);
+            drop = rx_filter_drop_packet(filter, data, whd_buffer_get_current_piece_size(iface->whd_driver, buf));
+
+            SYS_ARCH_PROTECT(lev);
+            filter->users--;
+            SYS_ARCH_UNPROTECT(lev);
         }
 
-        /* If the interface is not yet setup we drop the packet here */
-        if (net_interface->input == NULL || net_interface->input(buf, net_interface) != ERR_OK)
+        if (drop)
         {
             cy_buffer_release(buf, WHD_NETWORK_RX) ;
+            return NULL;
         }
     }
-}
 
-/* This function creates duplicate pbuf of input pbuf */
-static struct pbuf *pbuf_dup(const struct pbuf *orig)
-{
-    struct pbuf *p = pbuf_alloc(PBUF_LINK, orig->tot_len, PBUF_RAM);
-    if (p != NULL)
+#if LWIP_IPV4
+    if ((ethertype == ETHTYPE_ARP) && nw_interface->arp_probing)
     {
-        pbuf_copy(p, orig);
-        p->flags = orig->flags;
+        arp_revalidate_capture(nw_interface, data, whd_buffer_get_current_piece_size(iface->whd_driver, buf));
     }
-    return p;
+#endif
+
+#if OPTIMISTIC_DAD
+    if ((ethertype == ETHTYPE_IPV6) &&
+        optimistic_dad_rx_conflict(nw_interface, data, whd_buffer_get_current_piece_size(iface->whd_driver, buf)))
+    {
+        cy_buffer_release(buf, WHD_NETWORK_RX) ;
+        return NULL;
+    }
+#endif
+
+#if GATEWAY_ARP_PRESEED
+    if ((ethertype == ETHTYPE_IP) && nw_interface->is_dhcp_client_required)
+    {
+        gateway_arp_capture(nw_interface, data, whd_buffer_get_current_piece_size(iface->whd_driver, buf));
+    }
+#endif
+
+    return &nw_interface->netif;
 }
 
 /*
- * This function takes packets from the LwIP stack and sends them down to the radio.
- * If the radio is not ready, we return and error, otherwise we add a reference to
- * the packet for the radio driver and send the packet to the radio driver.  The radio
- * driver puts the packet into a send queue and will send based on another thread.  This
- * other thread will release the packet reference once the packet is actually sent.
+ * This function evaluates the RX filter of an interface role against a received packet.
+ * It returns true if the packet has to be dropped.
  */
-static err_t wifioutput(struct netif *iface, struct pbuf *p)
+static bool rx_filter_drop_packet(rx_filter_t *filter, const uint8_t *data, uint16_t length)
 {
-    if (whd_wifi_is_ready_to_transceive((whd_interface_t)iface->state) != WHD_SUCCESS)
+    static const uint8_t broadcast_mac[ETH_HWADDR_LEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    uint8_t  mac_class;
+    uint16_t ethertype;
+    uint8_t  protocol = 0;
+    uint16_t port     = 0;
+    uint8_t  best_rule = RX_FILTER_NO_RULE;
+    uint8_t  best_action = CY_LWIP_RX_FILTER_ACTION_PASS;
+    uint32_t i;
+
+    if (length < ETHERNET_HEADER_LENGTH)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Wi-Fi is not ready, packet not sent\n");
-        return ERR_INPROGRESS ;
+        return false;
     }
 
-    struct pbuf *whd_buf = pbuf_dup(p);
-    if (whd_buf == NULL)
+    if ((data[0] & 0x01) == 0)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "failed to allocate buffer for outgoing packet\n");
-        return ERR_MEM;
+        mac_class = 0;
     }
-    /* Call activity handler which is registered with argument as true
-     * indicating there is TX packet
-     */
-    if (activity_callback)
+    else if (memcmp(data, broadcast_mac, sizeof(broadcast_mac)) == 0)
     {
-        activity_callback(true);
+        mac_class = 2;
+    }
+    else
+    {
+        mac_class = 1;
     }
-    whd_network_send_ethernet_data((whd_interface_t)iface->state, whd_buf) ;
-    return ERR_OK ;
-}
-#if LWIP_IPV4 && LWIP_IGMP
-/*
- * This function is used to respond to IGMP (group management) requests.
- */
-static err_t igmp_filter(struct netif *iface, const ip4_addr_t *group, enum netif_mac_filter_action action)
-{
-    whd_mac_t mac = { MULTICAST_IP_TO_MAC((uint8_t*)group) };
 
-    switch ( action )
+    ethertype = (uint16_t)(data[12] << 8 | data[13]);
+    if ((ethertype == ETHTYPE_IP) && (length >= (ETHERNET_HEADER_LENGTH + IPV4_MIN_HEADER_LENGTH)))
     {
-        case NETIF_ADD_MAC_FILTER:
-            if ( whd_wifi_register_multicast_address( (whd_interface_t)iface->state, &mac ) != CY_RSLT_SUCCESS )
-            {
-                return ERR_VAL;
-            }
-            break;
+        uint16_t ip_header_length = (uint16_t)((data[ETHERNET_HEADER_LENGTH] & 0x0F) * 4);
+        uint16_t fragment_offset  = (uint16_t)(((data[20] & 0x1F) << 8) | data[21]);
 
-        case NETIF_DEL_MAC_FILTER:
-            if ( whd_wifi_unregister_multicast_address( (whd_interface_t)iface->state, &mac ) != CY_RSLT_SUCCESS )
+        protocol = data[23];
+        /* Only the first fragment carries the transport header */
+        if (((protocol == IP_PROTOCOL_TCP) || (protocol == IP_PROTOCOL_UDP)) && (fragment_offset == 0) &&
+            (length >= (ETHERNET_HEADER_LENGTH + ip_header_length + 4)))
+        {
+            port = (uint16_t)(data[ETHERNET_HEADER_LENGTH + ip_header_length + 2] << 8 | data[ETHERNET_HEADER_LENGTH + ip_header_length + 3]);
+        }
+    }
+    else if ((ethertype == ETHTYPE_IPV6) && (length >= (ETHERNET_HEADER_LENGTH + IPV6_HEADER_LENGTH)))
+    {
+        protocol = data[20];
+        if (((protocol == IP_PROTOCOL_TCP) || (protocol == IP_PROTOCOL_UDP)) &&
+            (length >= (ETHERNET_HEADER_LENGTH + IPV6_HEADER_LENGTH + 4)))
+        {
+            port = (uint16_t)(data[ETHERNET_HEADER_LENGTH + IPV6_HEADER_LENGTH + 2] << 8 | data[ETHERNET_HEADER_LENGTH + IPV6_HEADER_LENGTH + 3]);
+        }
+    }
+
+    /* One probe sequence per distinct combination of matched fields */
+    for (i = 0; i < filter->field_mask_count; i++)
+    {
+        uint8_t  fields     = filter->field_masks[i];
+        uint8_t  key        = (uint8_t)(fields | (mac_class << 4));
+        uint16_t key_type   = (fields & RX_FILTER_FIELD_ETHERTYPE) ? ethertype : 0;
+        uint8_t  key_proto  = (fields & RX_FILTER_FIELD_PROTOCOL)  ? protocol  : 0;
+        uint16_t key_port   = (fields & RX_FILTER_FIELD_PORT)      ? port      : 0;
+        uint32_t slot       = RX_FILTER_HASH(key, key_type, key_proto, key_port);
+        rx_filter_slot_t *entry;
+
+        while ((entry = &filter->table[slot])->rule != RX_FILTER_NO_RULE)
+        {
+            if ((entry->key == key) && (entry->ethertype == key_type) && (entry->protocol == key_proto) && (entry->port == key_port))
             {
-                return ERR_VAL;
+                if (entry->rule < best_rule)
+                {
+                    best_rule   = entry->rule;
+                    best_action = entry->action;
+                }
+                break;
             }
-            break;
+            slot = (slot + 1) & RX_FILTER_TABLE_MASK;
+        }
+    }
 
-        default:
-            return ERR_VAL;
+    if ((best_rule == RX_FILTER_NO_RULE) || (best_action == CY_LWIP_RX_FILTER_ACTION_PASS))
+    {
+        return false;
     }
 
-    return ERR_OK;
+    filter->hits[best_rule]++;
+    return (best_action == CY_LWIP_RX_FILTER_ACTION_DROP);
 }
-#endif
 
-#if LWIP_IPV6 && LWIP_IPV6_MLD
-/*
- * This function is called by lwIP to add or delete an entry in the IPv6 multicast filter table of the ethernet MAC.
- */
-static err_t mld_mac_filter(struct netif *iface, const ip6_addr_t *group, enum netif_mac_filter_action action)
+cy_rslt_t cy_lwip_rx_filter_set_rules(cy_lwip_nw_interface_role_t role, const cy_lwip_rx_filter_rule_t *rules, uint32_t count)
 {
-    whd_mac_t macaddr;
-    cy_rslt_t res;
-    const uint8_t *ptr = (const uint8_t *)group->addr;
+    rx_filter_t *filter;
+    uint32_t    i;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    /* Convert IPv6 multicast address to MAC address.
-     * The first two octets of the converted MAC address are the fixed values 0x33 and 0x33.
-     * And last four octets are the last four octets of the ipv6 multicast address.
+    if (((role != CY_LWIP_AP_NW_INTERFACE) && (role != CY_LWIP_STA_NW_INTERFACE)) ||
+        (count > CY_LWIP_RX_FILTER_MAX_RULES) || ((rules == NULL) && (count != 0)))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (((rules[i].mac_class & CY_LWIP_RX_FILTER_MAC_ANY) == 0) || (rules[i].action > CY_LWIP_RX_FILTER_ACTION_COUNT))
+        {
+            return CY_RSLT_LWIP_BAD_ARG;
+        }
+    }
+
+    /* The mutex is created on first use under the core lock, so that concurrent first callers create it once */
+    LOCK_TCPIP_CORE();
+    if ((rx_filter_mutex_ptr == NULL) && (cy_rtos_init_mutex(&rx_filter_mutex) == CY_RSLT_SUCCESS))
+    {
+        rx_filter_mutex_ptr = &rx_filter_mutex;
+    }
+    UNLOCK_TCPIP_CORE();
+    if ((rx_filter_mutex_ptr == NULL) || (cy_rtos_get_mutex(rx_filter_mutex_ptr, CY_RTOS_NEVER_TIMEOUT) != CY_RSLT_SUCCESS))
+    {
+        return CY_RSLT_LWIP_RX_FILTER_MUTEX_ERROR;
+    }
+
+    /* Compile into the table which is not published, once the RX threads still evaluating it are done.
+     * That takes at most one packet evaluation per thread; the delay lets lower priority RX threads run.
      */
-    macaddr.octet[0] = IPV6_MULTICAST_TO_MAC_PREFIX ;
-    macaddr.octet[1] = IPV6_MULTICAST_TO_MAC_PREFIX ;
-    macaddr.octet[2] = ptr[12] ;
-    macaddr.octet[3] = ptr[13] ;
-    macaddr.octet[4] = ptr[14] ;
-    macaddr.octet[5] = ptr[15] ;
+    filter = (rx_filters[role] == &rx_filter_tables[role][0]) ? &rx_filter_tables[role][1] : &rx_filter_tables[role][0];
+    while (filter->users != 0)
+    {
+        cy_rtos_delay_milliseconds(1);
+    }
 
-    switch ( action )
+    filter->field_mask_count = 0;
+    memset(filter->hits, 0, sizeof(filter->hits));
+    for (i = 0; i < CY_LWIP_RX_FILTER_TABLE_SIZE; i++)
     {
-        case NETIF_ADD_MAC_FILTER:
-            res = whd_wifi_register_multicast_address( (whd_interface_t)iface->state, &macaddr );
-            if (  res != CY_RSLT_SUCCESS )
+        filter->table[i].rule = RX_FILTER_NO_RULE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        const cy_lwip_rx_filter_rule_t *rule = &rules[i];
+        uint8_t  fields = 0;
+        uint8_t  mac_class;
+        uint32_t j;
+
+        fields |= (rule->ethertype   != 0) ? RX_FILTER_FIELD_ETHERTYPE : 0;
+        fields |= (rule->ip_protocol != 0) ? RX_FILTER_FIELD_PROTOCOL  : 0;
+        fields |= (rule->dst_port    != 0) ? RX_FILTER_FIELD_PORT      : 0;
+
+        for (j = 0; j < filter->field_mask_count; j++)
+        {
+            if (filter->field_masks[j] == fields)
             {
-                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_register_multicast_address call failed, err = %lx\n", res);
-                return ERR_VAL;
+                break;
             }
-            break;
+        }
+        if (j == filter->field_mask_count)
+        {
+            filter->field_masks[filter->field_mask_count++] = fields;
+        }
 
-        case NETIF_DEL_MAC_FILTER:
-            res = whd_wifi_unregister_multicast_address( (whd_interface_t)iface->state, &macaddr );
-            if ( res != CY_RSLT_SUCCESS )
+        for (mac_class = 0; mac_class < RX_FILTER_MAC_CLASS_COUNT; mac_class++)
+        {
+            uint8_t  key = (uint8_t)(fields | (mac_class << 4));
+            uint32_t slot;
+
+            if ((rule->mac_class & (1 << mac_class)) == 0)
             {
-                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_unregister_multicast_address call failed, err = %lx\n", res);
-                return ERR_VAL;
+                continue;
             }
-            break;
 
-        default:
-            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Invalid MAC Filter Action: %d\n", action);
-            return ERR_VAL;
+            slot = RX_FILTER_HASH(key, rule->ethertype, rule->ip_protocol, rule->dst_port);
+            while (filter->table[slot].rule != RX_FILTER_NO_RULE)
+            {
+                rx_filter_slot_t *entry = &filter->table[slot];
+                if ((entry->key == key) && (entry->ethertype == rule->ethertype) &&
+                    (entry->protocol == rule->ip_protocol) && (entry->port == rule->dst_port))
+                {
+                    /* An earlier rule already matches exactly these packets */
+                    break;
+                }
+                slot = (slot + 1) & RX_FILTER_TABLE_MASK;
+            }
+
+            if (filter->table[slot].rule == RX_FILTER_NO_RULE)
+            {
+                filter->table[slot].ethertype = rule->ethertype;
+                filter->table[slot].port      = rule->dst_port;
+                filter->table[slot].protocol  = rule->ip_protocol;
+                filter->table[slot].key       = key;
+                filter->table[slot].action    = (uint8_t)rule->action;
+                filter->table[slot].rule      = (uint8_t)i;
+            }
+        }
     }
 
-    return ERR_OK;
+    /* Packets received from now on are evaluated against the new rules */
+    SYS_ARCH_PROTECT(lev);
+    rx_filters[role] = (count != 0) ? filter : NULL;
+    SYS_ARCH_UNPROTECT(lev);
+
+    cy_rtos_set_mutex(rx_filter_mutex_ptr);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_lwip_rx_filter_get_hits(cy_lwip_nw_interface_role_t role, uint32_t rule_index, uint32_t *hits)
+{
+    rx_filter_t *filter;
+
+    if (((role != CY_LWIP_AP_NW_INTERFACE) && (role != CY_LWIP_STA_NW_INTERFACE)) ||
+        (rule_index >= CY_LWIP_RX_FILTER_MAX_RULES) || (hits == NULL))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    filter = rx_filters[role];
+    *hits = (filter != NULL) ? filter->hits[rule_index] : 0;
+    return CY_RSLT_SUCCESS;
+}
+
+/*
+ * This function takes packets from the radio driver and passes them into the
+ * LwIP stack.  If the stack is not initialized, or if the LwIP stack does not
+ * accept the packet, the packet is freed (dropped).
+ */
+void cy_network_process_ethernet_data(whd_interface_t iface, whd_buffer_t buf)
+{
+    struct netif *net_interface = rx_classify_packet(iface, buf);
+
+    if (net_interface == NULL)
+    {
+        return;
+    }
+
+    /* Call activity handler which is registered with argument as false
+     * indicating there is RX packet
+     */
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_RX);
+
+    /* If the interface is not yet setup we drop the packet here */
+    if (net_interface->input == NULL || net_interface->input(buf, net_interface) != ERR_OK)
+    {
+        cy_buffer_release(buf, WHD_NETWORK_RX) ;
+    }
+}
+
+/*
+ * This function takes a set of packets from the radio driver, classifies all of them
+ * and then passes the ones destined to LwIP into the stack under a single TCP/IP core
+ * lock acquisition. The core lock is recursive, so the per-packet lock taken by
+ * tcpip_input() does not block. The lock is released after CY_LWIP_RX_BATCH_MAX packets
+ * or once CY_LWIP_RX_BATCH_TIME_BUDGET_MS has elapsed to let other threads run.
+ */
+void cy_network_process_ethernet_data_batch(whd_interface_t iface, whd_buffer_t *bufs, uint32_t count)
+{
+    whd_buffer_t  pending[CY_LWIP_RX_BATCH_MAX];
+    struct netif  *net_interface = NULL;
+    uint32_t      index = 0;
+
+    if (bufs == NULL)
+    {
+        return;
+    }
+
+    while (index < count)
+    {
+        uint32_t pending_count = 0;
+        uint32_t i;
+        uint32_t lock_start;
+
+        /* Classify outside of the core lock; EAPOL and dropped packets never reach LwIP */
+        while ((index < count) && (pending_count < CY_LWIP_RX_BATCH_MAX))
+        {
+            whd_buffer_t buf   = bufs[index++];
+            struct netif *netif = rx_classify_packet(iface, buf);
+            if (netif != NULL)
+            {
+                net_interface = netif;
+                pending[pending_count++] = buf;
+            }
+        }
+
+        if (pending_count == 0)
+        {
+            continue;
+        }
+
+        /* If the interface is not yet setup we drop the packets here */
+        if (net_interface->input == NULL)
+        {
+            for (i = 0; i < pending_count; i++)
+            {
+                cy_buffer_release(pending[i], WHD_NETWORK_RX) ;
+            }
+            continue;
+        }
+
+        /* Call activity handler once for the whole batch, this also resumes the
+         * network stack before the core lock is taken
+         */
+        internal_network_activity_notify(CY_NETWORK_ACTIVITY_RX);
+
+        LOCK_TCPIP_CORE();
+        lock_start = sys_now();
+        for (i = 0; i < pending_count; i++)
+        {
+            if (net_interface->input(pending[i], net_interface) != ERR_OK)
+            {
+                cy_buffer_release(pending[i], WHD_NETWORK_RX) ;
+            }
+
+            if (((i + 1) < pending_count) && ((uint32_t)(sys_now() - lock_start) >= CY_LWIP_RX_BATCH_TIME_BUDGET_MS))
+            {
+                /* Time budget exhausted; give waiting threads a chance at the core lock */
+                UNLOCK_TCPIP_CORE();
+                LOCK_TCPIP_CORE();
+                lock_start = sys_now();
+            }
+        }
+        UNLOCK_TCPIP_CORE();
+    }
+}
+
+/* This function creates duplicate pbuf of input pbuf */
+static struct pbuf *pbuf_dup(const struct pbuf *orig)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_LINK, orig->tot_len, PBUF_RAM);
+    if (p != NULL)
+    {
+        pbuf_copy(p, orig);
+        p->flags = orig->flags;
+    }
+    return p;
+}
+
+#if CY_LWIP_TX_ZERO_COPY
+/*
+ * This function checks whether the pbuf can be passed to WHD without copying it.
+ * WHD expects a single contiguous buffer and prepends its bus header in place, so
+ * the pbuf must not be chained and must have enough headroom. PBUF_ROM and PBUF_REF
+ * pbufs cannot grow a header and are rejected by pbuf_add_header().
+ */
+static bool is_pbuf_zero_copy_capable(struct pbuf *p)
+{
+    if (p->next != NULL)
+    {
+        return false;
+    }
+
+    if (pbuf_add_header(p, CY_LWIP_TX_HEADROOM) != 0)
+    {
+        return false;
+    }
+    pbuf_remove_header(p, CY_LWIP_TX_HEADROOM);
+
+    return true;
 }
 #endif
 
 /*
- * This function is called when adding the Wi-Fi network interface to LwIP,
- * it actually performs the initialization for the netif interface.
+ * This function returns the buffer handed to the radio driver for an outgoing packet: the
+ * packet itself with a reference added, or a copy when the packet cannot be passed as-is.
+ * NULL is returned if no buffer could be allocated.
  */
-static err_t wifiinit(struct netif *iface)
+static struct pbuf *wifioutput_buffer(struct pbuf *p)
 {
-    cy_rslt_t res;
-    whd_mac_t macaddr;
-    whd_interface_t whd_iface = (whd_interface_t)iface->state;
-#ifdef COMPONENT_43907
-    whd_buffer_t buffer;
-    whd_buffer_t response;
-    uint32_t *wlan_rand = NULL;
+    struct pbuf *whd_buf;
+
+#if CY_LWIP_TX_ZERO_COPY
+    if (is_pbuf_zero_copy_capable(p))
+    {
+        /* Hand the LwIP buffer to WHD as-is, WHD drops this reference once the packet is sent */
+        pbuf_ref(p);
+        return p;
+    }
 #endif
 
-    /*
-     * Set the MAC address of the interface
-     */
-    res = whd_wifi_get_mac_address(whd_iface, &macaddr);
+    whd_buf = pbuf_dup(p);
+    if (whd_buf == NULL)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "failed to allocate buffer for outgoing packet\n");
+    }
+    return whd_buf;
+}
 
-    if (res != CY_RSLT_SUCCESS)
+#if CY_LWIP_TX_SCHEDULER
+/*
+ * This function maps an outgoing ethernet frame to a WMM access category. The user priority
+ * is taken from the three most significant bits of the DSCP carried in the IPv4 ToS or IPv6
+ * traffic class field. Frames which are not IP go to the best effort queue.
+ */
+static cy_lwip_tx_ac_t tx_sched_classify(struct pbuf *p)
+{
+    uint8_t  header[TX_SCHED_CLASSIFY_LENGTH];
+    uint16_t ethertype;
+    uint8_t  dscp;
+
+    if (pbuf_copy_partial(p, header, sizeof(header), 0) != sizeof(header))
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_get_mac_address call failed, err = %lx\n", res);
-        return res ;
-    }  
-    memcpy(&iface->hwaddr, &macaddr, sizeof(macaddr));
-    iface->hwaddr_len = sizeof(macaddr);
+        return CY_LWIP_TX_AC_BE;
+    }
 
-#ifdef COMPONENT_43907
-    /*
-     * 43907 kits does not have TRNG module. Get random number from WLAN and feed
-     * it as a seed to PRNGfunction.
-     * Before invoking whd_cdc_get_iovar_buffer, WHD interface should be initialized.
-     * However, wcminit is called from cy_lwip_add_interface and WHD interface is an
-     * input to the cy_lwip_add_interface API. So it is safe to invoke
-     * whd_cdc_get_iovar_buffer here.
-     */
-    if (NULL != whd_cdc_get_iovar_buffer(whd_iface->whd_driver, &buffer, WLC_GET_RANDOM_BYTES, IOVAR_STR_RAND) )
+    ethertype = (uint16_t)((header[12] << 8) | header[13]);
+    if (ethertype == ETHTYPE_IP)
     {
-        whd_result_t whd_result;
-        whd_result = whd_cdc_send_iovar(whd_iface, CDC_GET, buffer, &response);
-        if (whd_result != WHD_SUCCESS)
+        dscp = (uint8_t)(header[ETHERNET_HEADER_LENGTH + 1] >> 2);
+    }
+    else if (ethertype == ETHTYPE_IPV6)
+    {
+        dscp = (uint8_t)((((header[ETHERNET_HEADER_LENGTH] & 0x0F) << 4) | (header[ETHERNET_HEADER_LENGTH + 1] >> 4)) >> 2);
+    }
+    else
+    {
+        return CY_LWIP_TX_AC_BE;
+    }
+
+    /* 802.1D user priority to access category, as defined by WMM */
+    switch (dscp >> 3)
+    {
+        case 1:
+        case 2:
+            return CY_LWIP_TX_AC_BK;
+        case 4:
+        case 5:
+            return CY_LWIP_TX_AC_VI;
+        case 6:
+        case 7:
+            return CY_LWIP_TX_AC_VO;
+        default:
+            return CY_LWIP_TX_AC_BE;
+    }
+}
+
+/*
+ * This function frees the in-flight slots of the packets WHD released, dropping the
+ * reference the scheduler kept on them. Must be called with the TCP/IP core lock held.
+ */
+static void tx_sched_reap(void)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    tx_sched_in_flight_t *slot;
+    bool released;
+    int i;
+
+    for (i = 0; i < CY_LWIP_TX_SCHED_MAX_IN_FLIGHT; i++)
+    {
+        slot = &tx_sched_in_flight[i];
+        if (slot->p == NULL)
         {
-            whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
-            return ERR_IF;
+            continue;
+        }
+
+        /* WHD drops its reference from its own thread */
+        SYS_ARCH_PROTECT(lev);
+        released = (slot->p->ref <= slot->ref);
+        SYS_ARCH_UNPROTECT(lev);
+        if (released)
+        {
+            pbuf_free(slot->p);
+            slot->p = NULL;
+            tx_sched_in_flight_count--;
+        }
+    }
+}
+
+/*
+ * This function selects the queue the next packet is taken from. In strict mode, the
+ * highest priority queue which is not empty is served. In weighted mode, each queue may
+ * send up to its weight in packets per round, in priority order, before a new round starts.
+ */
+static tx_sched_queue_t *tx_sched_select(void)
+{
+    static const cy_lwip_tx_ac_t priority_order[CY_LWIP_TX_AC_MAX] =
+    {
+        CY_LWIP_TX_AC_VO, CY_LWIP_TX_AC_VI, CY_LWIP_TX_AC_BE, CY_LWIP_TX_AC_BK
+    };
+    tx_sched_queue_t *q;
+    int round;
+    int i;
+
+    for (round = 0; round < 2; round++)
+    {
+        for (i = 0; i < CY_LWIP_TX_AC_MAX; i++)
+        {
+            q = &tx_sched_queues[priority_order[i]];
+            if ((q->count > 0) && ((tx_sched_mode == CY_LWIP_TX_SCHED_MODE_STRICT) || (q->credit > 0)))
+            {
+                if (tx_sched_mode == CY_LWIP_TX_SCHED_MODE_WEIGHTED)
+                {
+                    q->credit--;
+                }
+                return q;
+            }
+        }
+
+        if (tx_sched_mode == CY_LWIP_TX_SCHED_MODE_STRICT)
+        {
+            break;
+        }
+        /* Every non-empty queue used up its credit, start a new round */
+        for (i = 0; i < CY_LWIP_TX_AC_MAX; i++)
+        {
+            tx_sched_queues[i].credit = tx_sched_queues[i].weight;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * This function hands queued packets to WHD until the in-flight limit is reached or all
+ * the queues are empty. A packet whose interface is no longer ready is parked in the hold
+ * queue, ahead of the next packets of the interface. Must be called with the TCP/IP core
+ * lock held.
+ */
+static void tx_sched_drain(void)
+{
+    tx_sched_queue_t *q;
+    tx_sched_entry_t entry;
+    tx_sched_in_flight_t *slot;
+
+    tx_sched_reap();
+
+    while (tx_sched_in_flight_count < CY_LWIP_TX_SCHED_MAX_IN_FLIGHT)
+    {
+        q = tx_sched_select();
+        if (q == NULL)
+        {
+            break;
+        }
+        entry = q->ring[q->head];
+        q->head = (uint16_t)((q->head + 1) % CY_LWIP_TX_SCHED_QUEUE_SIZE);
+        q->count--;
+
+        if (whd_wifi_is_ready_to_transceive(entry.whd_iface) != WHD_SUCCESS)
+        {
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+            if (tx_hold_enqueue(entry.whd_iface, entry.p) != ERR_OK)
+#endif
+            {
+                q->stats.dropped++;
+            }
+            pbuf_free(entry.p);
+            continue;
+        }
+
+        for (slot = tx_sched_in_flight; slot->p != NULL; slot++)
+        {
+        }
+        /* The scheduler keeps its reference, WHD gets one of its own */
+        slot->p   = entry.p;
+        slot->ref = entry.p->ref;
+        pbuf_ref(entry.p);
+        tx_sched_in_flight_count++;
+        q->stats.sent++;
+
+        /* Call activity handler which is registered with argument as true
+         * indicating there is TX packet
+         */
+        internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+        whd_network_send_ethernet_data(entry.whd_iface, entry.p);
+    }
+
+    if (tx_sched_in_flight_count > 0)
+    {
+        sys_untimeout(tx_sched_poll, NULL);
+        sys_timeout(CY_LWIP_TX_SCHED_POLL_INTERVAL_MS, tx_sched_poll, NULL);
+    }
+}
+
+/*
+ * This function checks the release of the packets in flight, and hands the queued packets
+ * to WHD as in-flight slots free up. Runs in the TCP/IP thread.
+ */
+static void tx_sched_poll(void *arg)
+{
+    (void)arg;
+    tx_sched_drain();
+}
+
+/*
+ * This function queues an outgoing packet in the queue of its access category and hands
+ * as many queued packets to WHD as the in-flight limit allows. ERR_WOULDBLOCK is returned
+ * when the queue is full, and ERR_MEM when no buffer could be allocated. Must be called
+ * with the TCP/IP core lock held.
+ */
+static err_t tx_sched_enqueue(whd_interface_t whd_iface, struct pbuf *p)
+{
+    tx_sched_queue_t *q = &tx_sched_queues[tx_sched_classify(p)];
+    struct pbuf *whd_buf;
+
+    if (q->count >= q->depth_limit)
+    {
+        tx_sched_drain();
+        return ERR_WOULDBLOCK;
+    }
+
+    whd_buf = wifioutput_buffer(p);
+    if (whd_buf == NULL)
+    {
+        return ERR_MEM;
+    }
+
+    q->ring[(q->head + q->count) % CY_LWIP_TX_SCHED_QUEUE_SIZE].whd_iface = whd_iface;
+    q->ring[(q->head + q->count) % CY_LWIP_TX_SCHED_QUEUE_SIZE].p = whd_buf;
+    q->count++;
+
+    q->stats.enqueued++;
+    if (q->count > q->stats.max_depth)
+    {
+        q->stats.max_depth = q->count;
+    }
+
+    tx_sched_drain();
+    return ERR_OK;
+}
+
+/*
+ * This function accounts an outgoing packet refused because the queue of its access category
+ * is full, and returns the error reported to LwIP, for which the packet is not sent.
+ */
+static err_t tx_sched_refuse(struct pbuf *p)
+{
+    tx_sched_queues[tx_sched_classify(p)].stats.dropped++;
+    return ERR_MEM;
+}
+
+/*
+ * This function drops the packets queued for the given WHD interface.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void tx_sched_flush(whd_interface_t whd_iface)
+{
+    tx_sched_queue_t *q;
+    tx_sched_entry_t entry;
+    uint16_t remaining;
+    int i;
+
+    for (i = 0; i < CY_LWIP_TX_AC_MAX; i++)
+    {
+        q = &tx_sched_queues[i];
+        /* Rotate the ring once, putting back the packets of the other interfaces */
+        for (remaining = q->count; remaining > 0; remaining--)
+        {
+            entry = q->ring[q->head];
+            q->head = (uint16_t)((q->head + 1) % CY_LWIP_TX_SCHED_QUEUE_SIZE);
+            if (entry.whd_iface != whd_iface)
+            {
+                q->ring[(q->head + q->count - 1) % CY_LWIP_TX_SCHED_QUEUE_SIZE] = entry;
+                continue;
+            }
+            q->count--;
+
+            q->stats.dropped++;
+            pbuf_free(entry.p);
+        }
+    }
+}
+
+/*
+ * This function configures the dequeue mode, the weights and the depth limits of the
+ * access category queues.
+ */
+cy_rslt_t cy_lwip_tx_sched_configure(const cy_lwip_tx_sched_config_t *config)
+{
+    int i;
+
+    if ((config == NULL) ||
+        ((config->mode != CY_LWIP_TX_SCHED_MODE_STRICT) && (config->mode != CY_LWIP_TX_SCHED_MODE_WEIGHTED)))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    for (i = 0; i < CY_LWIP_TX_AC_MAX; i++)
+    {
+        if ((config->depth_limit[i] == 0) || (config->depth_limit[i] > CY_LWIP_TX_SCHED_QUEUE_SIZE) ||
+            ((config->mode == CY_LWIP_TX_SCHED_MODE_WEIGHTED) && (config->weight[i] == 0)))
+        {
+            return CY_RSLT_LWIP_BAD_ARG;
+        }
+    }
+
+    LOCK_TCPIP_CORE();
+    tx_sched_mode = config->mode;
+    for (i = 0; i < CY_LWIP_TX_AC_MAX; i++)
+    {
+        /* Packets above a lowered depth limit stay queued, new ones are dropped until it is met */
+        tx_sched_queues[i].depth_limit = config->depth_limit[i];
+        tx_sched_queues[i].weight      = config->weight[i];
+        tx_sched_queues[i].credit      = config->weight[i];
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*
+ * This function returns the statistics of an access category queue.
+ */
+cy_rslt_t cy_lwip_tx_sched_get_stats(cy_lwip_tx_ac_t ac, cy_lwip_tx_sched_stats_t *stats)
+{
+    if (((uint32_t)ac >= CY_LWIP_TX_AC_MAX) || (stats == NULL))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    LOCK_TCPIP_CORE();
+    *stats = tx_sched_queues[ac].stats;
+    stats->depth = tx_sched_queues[ac].count;
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS;
+}
+#else
+cy_rslt_t cy_lwip_tx_sched_configure(const cy_lwip_tx_sched_config_t *config)
+{
+    (void)config;
+    return CY_RSLT_LWIP_TX_SCHEDULER_DISABLED;
+}
+
+cy_rslt_t cy_lwip_tx_sched_get_stats(cy_lwip_tx_ac_t ac, cy_lwip_tx_sched_stats_t *stats)
+{
+    (void)ac;
+    (void)stats;
+    return CY_RSLT_LWIP_TX_SCHEDULER_DISABLED;
+}
+#endif /* CY_LWIP_TX_SCHEDULER */
+
+/*
+ * This function hands a packet to the radio driver, through the TX scheduler when it is
+ * enabled. It adds a reference to the packet for the radio driver, or a copy when the
+ * packet cannot be passed as-is. The radio driver puts the packet into a send queue and
+ * will send based on another thread. This other thread will release the packet reference
+ * once the packet is actually sent. ERR_MEM is returned if no buffer could be allocated,
+ * and ERR_WOULDBLOCK if the TX scheduler queue of the packet is full.
+ */
+static err_t wifioutput_send(whd_interface_t whd_iface, struct pbuf *p)
+{
+#if CY_LWIP_TX_SCHEDULER
+    return tx_sched_enqueue(whd_iface, p);
+#else
+    struct pbuf *whd_buf = wifioutput_buffer(p);
+
+    if (whd_buf == NULL)
+    {
+        return ERR_MEM;
+    }
+    /* Call activity handler which is registered with argument as true
+     * indicating there is TX packet
+     */
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+    whd_network_send_ethernet_data(whd_iface, whd_buf) ;
+    return ERR_OK ;
+#endif /* CY_LWIP_TX_SCHEDULER */
+}
+
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+/*
+ * This function checks whether packets of the given WHD interface are parked in the hold queue.
+ */
+static bool tx_hold_contains(whd_interface_t whd_iface)
+{
+    uint32_t i;
+
+    for (i = 0; i < tx_hold_count; i++)
+    {
+        if (tx_hold_queue[i].whd_iface == whd_iface)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * This function parks a packet in the hold queue until WHD is ready to send it. The packet
+ * is referenced, or copied if its payload is not owned by the pbuf. ERR_MEM is returned when
+ * the queue is full, which makes TCP keep the segment and retry it later.
+ */
+static err_t tx_hold_enqueue(whd_interface_t whd_iface, struct pbuf *p)
+{
+    struct pbuf *q;
+
+    if (tx_hold_count >= CY_LWIP_TX_HOLD_QUEUE_SIZE)
+    {
+        return ERR_MEM;
+    }
+
+    if (PBUF_NEEDS_COPY(p))
+    {
+        q = pbuf_clone(PBUF_LINK, PBUF_RAM, p);
+        if (q == NULL)
+        {
+            return ERR_MEM;
+        }
+    }
+    else
+    {
+        pbuf_ref(p);
+        q = p;
+    }
+
+    tx_hold_queue[tx_hold_count].whd_iface = whd_iface;
+    tx_hold_queue[tx_hold_count].p         = q;
+    tx_hold_queue[tx_hold_count].time      = sys_now();
+    if (tx_hold_count++ == 0)
+    {
+        sys_timeout(CY_LWIP_TX_HOLD_POLL_INTERVAL_MS, tx_hold_poll, NULL);
+    }
+    return ERR_OK;
+}
+
+/*
+ * This function sends the parked packets of the interfaces WHD is ready for again, and drops
+ * the packets parked for longer than CY_LWIP_TX_HOLD_MAX_AGE_MS. Packets of an interface are
+ * sent in order: once one of them cannot be sent, the following ones stay parked.
+ * Returns the number of packets sent.
+ */
+static uint32_t tx_hold_flush(void)
+{
+    whd_interface_t blocked[CY_LWIP_TX_HOLD_QUEUE_SIZE];
+    uint32_t blocked_count = 0;
+    uint32_t sent = 0;
+    uint32_t kept = 0;
+    uint32_t now = sys_now();
+    tx_hold_entry_t entry;
+    uint32_t i;
+    uint32_t j;
+
+    /* Packets the TX scheduler parks while this runs are appended, and visited as well */
+    for (i = 0; i < tx_hold_count; i++)
+    {
+        entry = tx_hold_queue[i];
+
+        if ((uint32_t)(now - entry.time) >= CY_LWIP_TX_HOLD_MAX_AGE_MS)
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Wi-Fi was not ready in time, packet not sent\n");
+            pbuf_free(entry.p);
+            continue;
+        }
+
+        for (j = 0; (j < blocked_count) && (blocked[j] != entry.whd_iface); j++)
+        {
+        }
+
+        if ((j == blocked_count) &&
+            (whd_wifi_is_ready_to_transceive(entry.whd_iface) == WHD_SUCCESS) &&
+            (wifioutput_send(entry.whd_iface, entry.p) == ERR_OK))
+        {
+            /* WHD holds its own reference or copy of the packet */
+            pbuf_free(entry.p);
+            sent++;
+            continue;
+        }
+
+        if (j == blocked_count)
+        {
+            blocked[blocked_count++] = entry.whd_iface;
+        }
+        tx_hold_queue[kept++] = entry;
+    }
+    tx_hold_count = kept;
+
+    return sent;
+}
+
+/*
+ * This function periodically retries the parked packets while the hold queue is not empty.
+ * Once packets went out, TCP connections which had a segment refused with ERR_MEM are
+ * given a chance to transmit right away instead of waiting for the TCP fast timer.
+ */
+static void tx_hold_poll(void *arg)
+{
+    (void)arg;
+
+    if (tx_hold_flush() > 0)
+    {
+#if LWIP_TCP
+        tcp_txnow();
+#endif
+    }
+
+    if (tx_hold_count > 0)
+    {
+        sys_timeout(CY_LWIP_TX_HOLD_POLL_INTERVAL_MS, tx_hold_poll, NULL);
+    }
+}
+
+/*
+ * This function drops the packets parked for the given WHD interface.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void tx_hold_discard(whd_interface_t whd_iface)
+{
+    uint32_t kept = 0;
+    uint32_t i;
+
+    for (i = 0; i < tx_hold_count; i++)
+    {
+        if (tx_hold_queue[i].whd_iface == whd_iface)
+        {
+            pbuf_free(tx_hold_queue[i].p);
+            continue;
+        }
+        tx_hold_queue[kept++] = tx_hold_queue[i];
+    }
+    tx_hold_count = kept;
+
+    if (tx_hold_count == 0)
+    {
+        sys_untimeout(tx_hold_poll, NULL);
+    }
+}
+#endif /* CY_LWIP_TX_HOLD_QUEUE_SIZE > 0 */
+
+/*
+ * This function takes packets from the LwIP stack and sends them down to the radio.
+ * If the radio is not ready, or no buffer can be allocated for the radio driver, the
+ * packet is parked in the hold queue and sent once the radio is ready again. Packets
+ * are only dropped when the hold queue is full, or the TX scheduler queue of the packet
+ * is full, in which case ERR_MEM is returned.
+ */
+static err_t wifioutput(struct netif *iface, struct pbuf *p)
+{
+    whd_interface_t whd_iface = (whd_interface_t)iface->state;
+    err_t err;
+
+#if OPTIMISTIC_DAD
+    optimistic_dad_tx_restrict(whd_iface, p);
+#endif
+
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+    /* Packets parked earlier for this interface go first, to preserve ordering */
+    if ((tx_hold_count > 0) && tx_hold_contains(whd_iface))
+    {
+        tx_hold_flush();
+    }
+
+    if ((tx_hold_count == 0) || !tx_hold_contains(whd_iface))
+    {
+        if (whd_wifi_is_ready_to_transceive(whd_iface) == WHD_SUCCESS)
+        {
+            err = wifioutput_send(whd_iface, p);
+#if CY_LWIP_TX_SCHEDULER
+            if (err == ERR_WOULDBLOCK)
+            {
+                /* Not parked, which would hold the packets of every access category behind it */
+                return tx_sched_refuse(p);
+            }
+#endif
+            if (err != ERR_MEM)
+            {
+                return err;
+            }
+        }
+    }
+
+    err = tx_hold_enqueue(whd_iface, p);
+    if (err != ERR_OK)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "TX hold queue is full, packet not sent\n");
+    }
+    return err;
+#else
+    if (whd_wifi_is_ready_to_transceive(whd_iface) != WHD_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Wi-Fi is not ready, packet not sent\n");
+        return ERR_INPROGRESS ;
+    }
+
+    err = wifioutput_send(whd_iface, p);
+#if CY_LWIP_TX_SCHEDULER
+    if (err == ERR_WOULDBLOCK)
+    {
+        return tx_sched_refuse(p);
+    }
+#endif
+    return err;
+#endif
+}
+#if LWIP_IPV4 && LWIP_IGMP
+/*
+ * This function is used to respond to IGMP (group management) requests.
+ */
+static err_t igmp_filter(struct netif *iface, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+    whd_mac_t mac = { MULTICAST_IP_TO_MAC((uint8_t*)group) };
+
+    switch ( action )
+    {
+        case NETIF_ADD_MAC_FILTER:
+            if ( whd_wifi_register_multicast_address( (whd_interface_t)iface->state, &mac ) != CY_RSLT_SUCCESS )
+            {
+                return ERR_VAL;
+            }
+            break;
+
+        case NETIF_DEL_MAC_FILTER:
+            if ( whd_wifi_unregister_multicast_address( (whd_interface_t)iface->state, &mac ) != CY_RSLT_SUCCESS )
+            {
+                return ERR_VAL;
+            }
+            break;
+
+        default:
+            return ERR_VAL;
+    }
+
+    return ERR_OK;
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+/*
+ * This function is called by lwIP to add or delete an entry in the IPv6 multicast filter table of the ethernet MAC.
+ */
+static err_t mld_mac_filter(struct netif *iface, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+    whd_mac_t macaddr;
+    cy_rslt_t res;
+    const uint8_t *ptr = (const uint8_t *)group->addr;
+
+    /* Convert IPv6 multicast address to MAC address.
+     * The first two octets of the converted MAC address are the fixed values 0x33 and 0x33.
+     * And last four octets are the last four octets of the ipv6 multicast address.
+     */
+    macaddr.octet[0] = IPV6_MULTICAST_TO_MAC_PREFIX ;
+    macaddr.octet[1] = IPV6_MULTICAST_TO_MAC_PREFIX ;
+    macaddr.octet[2] = ptr[12] ;
+    macaddr.octet[3] = ptr[13] ;
+    macaddr.octet[4] = ptr[14] ;
+    macaddr.octet[5] = ptr[15] ;
+
+    switch ( action )
+    {
+        case NETIF_ADD_MAC_FILTER:
+            res = whd_wifi_register_multicast_address( (whd_interface_t)iface->state, &macaddr );
+            if (  res != CY_RSLT_SUCCESS )
+            {
+                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_register_multicast_address call failed, err = %lx\n", res);
+                return ERR_VAL;
+            }
+            break;
+
+        case NETIF_DEL_MAC_FILTER:
+            res = whd_wifi_unregister_multicast_address( (whd_interface_t)iface->state, &macaddr );
+            if ( res != CY_RSLT_SUCCESS )
+            {
+                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_unregister_multicast_address call failed, err = %lx\n", res);
+                return ERR_VAL;
+            }
+            break;
+
+        default:
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Invalid MAC Filter Action: %d\n", action);
+            return ERR_VAL;
+    }
+
+    return ERR_OK;
+}
+#endif
+
+/*
+ * This function is called when adding the Wi-Fi network interface to LwIP,
+ * it actually performs the initialization for the netif interface.
+ */
+static err_t wifiinit(struct netif *iface)
+{
+    cy_rslt_t res;
+    whd_mac_t macaddr;
+    whd_interface_t whd_iface = (whd_interface_t)iface->state;
+#ifdef COMPONENT_43907
+    whd_buffer_t buffer;
+    whd_buffer_t response;
+    uint32_t *wlan_rand = NULL;
+#endif
+
+    /*
+     * Set the MAC address of the interface
+     */
+    res = whd_wifi_get_mac_address(whd_iface, &macaddr);
+
+    if (res != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "whd_wifi_get_mac_address call failed, err = %lx\n", res);
+        return res ;
+    }  
+    memcpy(&iface->hwaddr, &macaddr, sizeof(macaddr));
+    iface->hwaddr_len = sizeof(macaddr);
+
+#ifdef COMPONENT_43907
+    /*
+     * 43907 kits does not have TRNG module. Get random number from WLAN and feed
+     * it as a seed to PRNGfunction.
+     * Before invoking whd_cdc_get_iovar_buffer, WHD interface should be initialized.
+     * However, wcminit is called from cy_lwip_add_interface and WHD interface is an
+     * input to the cy_lwip_add_interface API. So it is safe to invoke
+     * whd_cdc_get_iovar_buffer here.
+     */
+    if (NULL != whd_cdc_get_iovar_buffer(whd_iface->whd_driver, &buffer, WLC_GET_RANDOM_BYTES, IOVAR_STR_RAND) )
+    {
+        whd_result_t whd_result;
+        whd_result = whd_cdc_send_iovar(whd_iface, CDC_GET, buffer, &response);
+        if (whd_result != WHD_SUCCESS)
+        {
+            whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
+            return ERR_IF;
+        }
+        wlan_rand = (uint32_t *)whd_buffer_get_current_piece_data_pointer(whd_iface->whd_driver, response);
+        if ( wlan_rand == NULL )
+        {
+            whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
+            return ERR_IF;
+        }
+    }
+    else
+    {
+        return ERR_IF;
+    }
+
+    /* Initialize the mutex to protect PRNG well512 state */
+    if (cy_prng_mutex_ptr == NULL)
+    {
+        cy_prng_mutex_ptr = &cy_prng_mutex;
+        cy_rtos_init_mutex(cy_prng_mutex_ptr);
+    }
+    /* Feed the random number obtained from WLAN to WELL512
+     * algorithm as initial seed value.
+     */
+    cy_prng_add_entropy((const void *)wlan_rand, 4);
+
+    /*
+     * Free the whd buffer used to get the random number from WLAN.
+     */
+    whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
+#endif
+    /*
+     * Setup the information associated with sending packets
+     */
+#if LWIP_IPV4
+    iface->output = etharp_output;
+#endif
+    iface->linkoutput = wifioutput;
+    iface->mtu = WHD_LINK_MTU;
+    iface->flags |= (NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP) ;
+#ifdef LWIP_IPV6_MLD
+    iface->flags |= NETIF_FLAG_MLD6;
+#endif
+    /*
+     * Set the interface name for the interface
+     */
+    iface->name[0] = 'w' ;
+    iface->name[1] = 'l' ;
+
+#if LWIP_IPV4 && LWIP_IGMP
+    netif_set_igmp_mac_filter(iface, igmp_filter) ;
+#endif
+
+
+#if LWIP_IPV6 == 1
+    /*
+     * Filter output packets for IPV6 through the ethernet output
+     * function for IPV6.
+     */
+    iface->output_ip6 = ethip6_output ;
+
+    /*
+     * Automatically generate a unicast IP address based on
+     * neighbor discovery.
+     */
+    iface->ip6_autoconfig_enabled = 1 ;
+
+    /*
+     * Create a link local IPV6 address
+     */
+    netif_create_ip6_linklocal_address(iface, 1);
+
+    /*
+     * Tell the radio that we want to listen to solicited-node multicast
+     * packets.  These packets are part of the IPV6 neighbor discovery
+     * process.
+     */
+    macaddr.octet[0] = 0x33 ;
+    macaddr.octet[1] = 0x33 ;
+    macaddr.octet[2] = 0xff ;
+    whd_wifi_register_multicast_address(iface->state, &macaddr) ;
+
+    /*
+     * Tell the radio that we want to listen to the multicast address
+     * that targets all IPV6 devices.  These packets are part of the IPV6
+     * neighbor discovery process.
+     */
+    memset(&macaddr, 0, sizeof(macaddr)) ;
+    macaddr.octet[0] = 0x33 ;
+    macaddr.octet[1] = 0x33 ;
+    macaddr.octet[5] = 0x01 ;
+    whd_wifi_register_multicast_address(iface->state, &macaddr) ;
+
+#if LWIP_IPV6_MLD
+    /*
+     * Register mld mac filter callback function that will be called by lwIP to add or delete an
+     * entry in the IPv6 multicast filter table of the ethernet MAC.
+     */
+    netif_set_mld_mac_filter(iface, mld_mac_filter);
+#endif
+#endif
+    return 0 ;
+}
+
+/*
+ * This is the main entry point in this file.  This function takes a WHD radio driver
+ * handle, interface type and static IP address, and adds interface to LwIP.
+ * note : static IP address is optional for STA interface.
+ */
+cy_rslt_t cy_lwip_add_interface(cy_lwip_nw_interface_t *iface, ip_static_addr_t *static_ipaddr)
+{
+#if LWIP_IPV4
+    ip4_addr_t ipaddr, netmask, gateway ;
+#endif
+    nw_interface_entry_t *nw_interface;
+    nw_interface_entry_t **tail;
+    bool is_first_sta = true;
+
+    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    /* static IP addr is mandatory for AP */
+    if((iface->role == CY_LWIP_AP_NW_INTERFACE) && (static_ipaddr == NULL))
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error static IP addr cannot be NULL for AP interface \n");
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    if (find_nw_interface(iface->whd_iface) != NULL)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+    /* Reuse the entry of a removed interface, or allocate a new one */
+    nw_interface = nw_interface_free_list;
+    if (nw_interface != NULL)
+    {
+        nw_interface_free_list = nw_interface->next;
+    }
+    else
+    {
+        nw_interface = (nw_interface_entry_t *)malloc(sizeof(nw_interface_entry_t));
+        if (nw_interface == NULL)
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error allocating interface \n");
+            return CY_RSLT_LWIP_ERROR_ADDING_INTERFACE;
+        }
+    }
+    memset(nw_interface, 0, sizeof(nw_interface_entry_t));
+    nw_interface->whd_iface = iface->whd_iface;
+    nw_interface->role      = iface->role;
+
+#if LWIP_IPV4
+    /* Assign the IP address if static, otherwise, zero the IP address */
+    if (static_ipaddr != NULL)
+    {
+        memcpy(&gateway, &static_ipaddr->gateway, sizeof(gateway));
+        memcpy(&ipaddr, &static_ipaddr->addr, sizeof(ipaddr));
+        memcpy(&netmask, &static_ipaddr->netmask, sizeof(netmask));
+    }
+    else
+    {
+        memset(&gateway, 0, sizeof(gateway));
+        memset(&ipaddr, 0, sizeof(ipaddr));
+        memset(&netmask, 0, sizeof(netmask));
+    }
+
+    /* Add the interface to LwIP and make it the default */
+    if(netifapi_netif_add(&nw_interface->netif, &ipaddr, &netmask, &gateway, iface->whd_iface, wifiinit, tcpip_input) != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error adding interface \n");
+        nw_interface->whd_iface = NULL;
+        nw_interface->next = nw_interface_free_list;
+        nw_interface_free_list = nw_interface;
+        return CY_RSLT_LWIP_ERROR_ADDING_INTERFACE;
+    }
+#else
+    if(netifapi_netif_add(&nw_interface->netif, iface->whd_iface, wifiinit, tcpip_input) != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error adding interface \n");
+        nw_interface->whd_iface = NULL;
+        nw_interface->next = nw_interface_free_list;
+        nw_interface_free_list = nw_interface;
+        return CY_RSLT_LWIP_ERROR_ADDING_INTERFACE;
+    }
+#endif
+
+    /* Append the interface to the list and publish it to the receive path */
+    for (tail = &nw_interface_list; *tail != NULL; tail = &(*tail)->next)
+    {
+        if ((*tail)->role == CY_LWIP_STA_NW_INTERFACE)
+        {
+            is_first_sta = false;
+        }
+    }
+    *tail = nw_interface;
+    nw_interface_lookup[iface->whd_iface->ifidx] = nw_interface;
+
+    if(iface->role == CY_LWIP_STA_NW_INTERFACE)
+    {
+        if(static_ipaddr == NULL)
+        {
+            nw_interface->is_dhcp_client_required = true;
+        }
+        if(is_first_sta)
+        {
+            netifapi_netif_set_default(&nw_interface->netif) ;
+        }
+    }
+
+    /*
+     * Register a handler for any address changes
+     * Note : The handler will also be called when the interface or its link
+     * goes up or down
+     */
+    LOCK_TCPIP_CORE();
+    if(!nw_interface_ext_callback_registered)
+    {
+        netif_add_ext_callback(&nw_interface_netif_ext_callback, nw_interface_ext_callback);
+        nw_interface_ext_callback_registered = true;
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS ;
+}
+
+/*
+ * This function returns the first interface added with the given role.
+ */
+struct netif* cy_lwip_get_interface(cy_lwip_nw_interface_role_t role)
+{
+    nw_interface_entry_t *nw_interface;
+
+    if((role != CY_LWIP_AP_NW_INTERFACE) && (role != CY_LWIP_STA_NW_INTERFACE))
+    {
+        return NULL;
+    }
+
+    for (nw_interface = nw_interface_list; nw_interface != NULL; nw_interface = nw_interface->next)
+    {
+        if (nw_interface->role == role)
+        {
+            return &nw_interface->netif;
+        }
+    }
+    return NULL;
+}
+
+struct netif* cy_lwip_get_interface_by_whd_iface(whd_interface_t whd_iface)
+{
+    nw_interface_entry_t *nw_interface = find_nw_interface(whd_iface);
+
+    return (nw_interface != NULL) ? &nw_interface->netif : NULL;
+}
+
+cy_rslt_t cy_lwip_remove_interface(cy_lwip_nw_interface_t *iface)
+{
+    nw_interface_entry_t *nw_interface;
+    nw_interface_entry_t **prev;
+
+    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    /* Interface can be removed only if the interface was previously added and network is down */
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error Interface doesn't exist \n");
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
+    }
+
+    if(nw_interface->is_up || (nw_interface->up_wait != 0))
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error removing interface, bring down the network before removing the interface \n");
+        return CY_RSLT_LWIP_ERROR_REMOVING_INTERFACE;
+    }
+    /* stop delivering received packets to the interface */
+    nw_interface_lookup[iface->whd_iface->ifidx] = NULL;
+    /* notify the removal, the interface can no longer be found from the LwIP events */
+    LOCK_TCPIP_CORE();
+    ip_change_notify(nw_interface, LWIP_NSC_NETIF_REMOVED, NULL);
+    UNLOCK_TCPIP_CORE();
+    /* remove the interface */
+    netifapi_netif_remove(&nw_interface->netif);
+#if (CY_LWIP_TX_HOLD_QUEUE_SIZE > 0) || CY_LWIP_TX_SCHEDULER
+    /* drop the packets still queued for the interface */
+    LOCK_TCPIP_CORE();
+#if CY_LWIP_TX_HOLD_QUEUE_SIZE > 0
+    tx_hold_discard(iface->whd_iface);
+#endif
+#if CY_LWIP_TX_SCHEDULER
+    tx_sched_flush(iface->whd_iface);
+#endif
+    UNLOCK_TCPIP_CORE();
+#endif
+
+    for (prev = &nw_interface_list; *prev != nw_interface; prev = &(*prev)->next)
+    {
+    }
+    *prev = nw_interface->next;
+    nw_interface->whd_iface = NULL;
+    nw_interface->next = nw_interface_free_list;
+    nw_interface_free_list = nw_interface;
+
+#ifdef COMPONENT_43907
+    /* cy_prng_mutex_ptr is initialized when the first network intefrace is initialized.
+     * Deinitialize the mutex only after all the interfaces are deinitiazed.
+     */
+    if (nw_interface_list == NULL)
+    {
+        if (cy_prng_mutex_ptr != NULL)
+        {
+            cy_rtos_deinit_mutex(cy_prng_mutex_ptr);
+            cy_prng_mutex_ptr = NULL;
+        }
+    }
+#endif
+    return CY_RSLT_SUCCESS;
+}
+
+#if CY_LWIP_PHASE_TIMING
+/*
+ * This function starts the timing record of a network bring-up or tear down.
+ */
+static void phase_timing_start(cy_lwip_phase_record_t *record, cy_lwip_phase_op_t op, cy_lwip_nw_interface_role_t role)
+{
+    int i;
+
+    record->op         = op;
+    record->role       = role;
+    record->result     = CY_RSLT_SUCCESS;
+    record->start_time = sys_now();
+    record->duration   = 0;
+    record->dhcp_lease_cached = false;
+    for (i = 0; i < CY_LWIP_PHASE_MAX; i++)
+    {
+        record->phase_start[i] = CY_LWIP_PHASE_NOT_RUN;
+        record->phase_end[i]   = CY_LWIP_PHASE_NOT_RUN;
+    }
+}
+
+/*
+ * This function records the time a phase starts or ends at.
+ */
+static void phase_timing_mark(cy_lwip_phase_record_t *record, cy_lwip_phase_t phase, bool begin)
+{
+    uint32_t elapsed = (uint32_t)(sys_now() - record->start_time);
+
+    if (begin)
+    {
+        record->phase_start[phase] = elapsed;
+    }
+    else
+    {
+        record->phase_end[phase] = elapsed;
+    }
+}
+
+/*
+ * This function completes a timing record and adds it to the ring of recent records,
+ * overwriting the oldest one once full.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void phase_timing_finish(cy_lwip_phase_record_t *record, cy_rslt_t result)
+{
+    record->result   = result;
+    record->duration = (uint32_t)(sys_now() - record->start_time);
+
+    phase_timing_records[phase_timing_next] = *record;
+    phase_timing_next = (phase_timing_next + 1) % CY_LWIP_PHASE_TIMING_RECORDS;
+    if (phase_timing_count < CY_LWIP_PHASE_TIMING_RECORDS)
+    {
+        phase_timing_count++;
+    }
+}
+
+cy_rslt_t cy_lwip_get_phase_timing(cy_lwip_phase_record_t *records, uint32_t max_count, uint32_t *count)
+{
+    uint32_t first;
+    uint32_t n;
+    uint32_t i;
+
+    if ((records == NULL) || (count == NULL))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    LOCK_TCPIP_CORE();
+    n = (phase_timing_count < max_count) ? phase_timing_count : max_count;
+    /* Return the n most recent records, oldest first */
+    first = (phase_timing_next + CY_LWIP_PHASE_TIMING_RECORDS - n) % CY_LWIP_PHASE_TIMING_RECORDS;
+    for (i = 0; i < n; i++)
+    {
+        records[i] = phase_timing_records[(first + i) % CY_LWIP_PHASE_TIMING_RECORDS];
+    }
+    UNLOCK_TCPIP_CORE();
+
+    *count = n;
+    return CY_RSLT_SUCCESS;
+}
+#else
+cy_rslt_t cy_lwip_get_phase_timing(cy_lwip_phase_record_t *records, uint32_t max_count, uint32_t *count)
+{
+    (void)records;
+    (void)max_count;
+    (void)count;
+    return CY_RSLT_LWIP_PHASE_TIMING_DISABLED;
+}
+#endif /* CY_LWIP_PHASE_TIMING */
+
+#if DHCP_LEASE_CACHE
+/*
+ * This function looks up the cached lease of a network. Both the SSID and the BSSID must
+ * match: another network may use the same SSID, and its server would silently ignore an
+ * INIT-REBOOT for an address it never leased. Must be called with the TCP/IP core lock held.
+ */
+static int dhcp_lease_find(const cy_lwip_dhcp_lease_t *key)
+{
+    uint32_t i;
+
+    for (i = 0; i < dhcp_lease_count; i++)
+    {
+        if ((dhcp_lease_cache[i].ssid_len == key->ssid_len) &&
+            (memcmp(dhcp_lease_cache[i].ssid, key->ssid, key->ssid_len) == 0) &&
+            (memcmp(dhcp_lease_cache[i].bssid, key->bssid, sizeof(key->bssid)) == 0))
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * This function returns the time the leases are stamped with, in seconds: the clock of the
+ * get_time callback when one is configured, the system uptime otherwise.
+ */
+static uint32_t dhcp_lease_now(void)
+{
+    if (dhcp_lease_config.get_time != NULL)
+    {
+        return dhcp_lease_config.get_time(dhcp_lease_config.arg);
+    }
+    return sys_now() / 1000;
+}
+
+/*
+ * This function checks whether a cached lease has ended. The lease is timed from its first
+ * bind, renewals are not accounted for, so that a lease is never used past its end.
+ */
+static bool dhcp_lease_expired(const cy_lwip_dhcp_lease_t *lease)
+{
+    if (lease->lease_time == 0xFFFFFFFF)
+    {
+        /* Infinite lease */
+        return false;
+    }
+    return ((uint32_t)(dhcp_lease_now() - lease->obtained) >= lease->lease_time);
+}
+
+/*
+ * This function records the network the STA interface is joined to, used as the key of its
+ * DHCP lease. It queries WHD and must be called without the TCP/IP core lock held.
+ */
+static void dhcp_lease_get_key(nw_interface_entry_t *nw_interface)
+{
+    whd_bss_info_t ap_info;
+    whd_security_t security;
+    cy_lwip_dhcp_lease_t *key = &nw_interface->lease_key;
+
+    memset(key, 0, sizeof(*key));
+    if (whd_wifi_get_ap_info(nw_interface->whd_iface, &ap_info, &security) != WHD_SUCCESS)
+    {
+        return;
+    }
+    key->ssid_len = (ap_info.SSID_len > sizeof(key->ssid)) ? (uint8_t)sizeof(key->ssid) : ap_info.SSID_len;
+    memcpy(key->ssid, ap_info.SSID, key->ssid_len);
+    memcpy(key->bssid, ap_info.BSSID.octet, sizeof(key->bssid));
+}
+
+/*
+ * This function watches the INIT-REBOOT of a cached lease assigned to the interface. LwIP
+ * removes the address on a DHCPNAK, but keeps it when the server does not answer and the
+ * REBOOTING retries run out; the client then falls back to DHCPDISCOVER and the cached
+ * address must no longer be used. Runs from the LwIP timers, with the TCP/IP core lock held.
+ */
+static void dhcp_lease_reboot_check(void *arg)
+{
+    nw_interface_entry_t *nw_interface = (nw_interface_entry_t *)arg;
+    struct netif *netif = &nw_interface->netif;
+    struct dhcp *dhcp = netif_dhcp_data(netif);
+
+    if (dhcp == NULL)
+    {
+        return;
+    }
+    if (dhcp->state == DHCP_STATE_REBOOTING)
+    {
+        sys_timeout(DHCP_FINE_TIMER_MSECS, dhcp_lease_reboot_check, nw_interface);
+        return;
+    }
+    if ((dhcp->state != DHCP_STATE_BOUND) && !ip4_addr_isany_val(*netif_ip4_addr(netif)))
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "Cached DHCP lease not confirmed, removing %s \n", ip4addr_ntoa(netif_ip4_addr(netif)));
+        netif_set_addr(netif, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4);
+    }
+}
+
+/*
+ * This function prepares the DHCP client started on a STA interface whose link is still
+ * down to request the cached lease of the network with an INIT-REBOOT DHCPREQUEST once the
+ * link comes up. LwIP falls back to DHCPDISCOVER if the server rejects the address or does
+ * not answer. Returns true if the cached address was assigned to the interface right away.
+ * Must be called with the TCP/IP core lock held.
+ */
+static bool dhcp_lease_reboot(nw_interface_entry_t *nw_interface)
+{
+    struct dhcp *dhcp = netif_dhcp_data(&nw_interface->netif);
+    cy_lwip_dhcp_lease_t *lease;
+    ip4_addr_t ip_addr, netmask, gateway;
+    int index;
+
+    if ((nw_interface->lease_key.ssid_len == 0) || (dhcp == NULL) ||
+        ((index = dhcp_lease_find(&nw_interface->lease_key)) < 0))
+    {
+        return false;
+    }
+    lease = &dhcp_lease_cache[index];
+    if (dhcp_lease_expired(lease))
+    {
+        return false;
+    }
+
+    /*
+     * dhcp_network_changed() sends the DHCPREQUEST for offered_ip_addr in the REBOOTING state.
+     * dhcp_set_state() is private to LwIP: the state change is made as it makes it in LwIP 2.1,
+     * which is checked at build time, so that the retries and the request timeout start over.
+     */
+    ip4_addr_set_u32(&dhcp->offered_ip_addr, lease->ip_addr);
+    if (dhcp->state != DHCP_STATE_REBOOTING)
+    {
+        dhcp->state           = DHCP_STATE_REBOOTING;
+        dhcp->tries           = 0;
+        dhcp->request_timeout = 0;
+    }
+    wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "Requesting cached DHCP lease %s \n", ip4addr_ntoa(&dhcp->offered_ip_addr));
+
+    if (!dhcp_lease_config.use_cached_address)
+    {
+        return false;
+    }
+
+    /* The address is removed by LwIP on a DHCPNAK, and by dhcp_lease_reboot_check() if no server answers */
+    ip4_addr_set_u32(&ip_addr, lease->ip_addr);
+    ip4_addr_set_u32(&netmask, lease->netmask);
+    ip4_addr_set_u32(&gateway, lease->gateway);
+    netif_set_addr(&nw_interface->netif, &ip_addr, &netmask, &gateway);
+    sys_untimeout(dhcp_lease_reboot_check, nw_interface);
+    sys_timeout(DHCP_FINE_TIMER_MSECS, dhcp_lease_reboot_check, nw_interface);
+    return true;
+}
+
+/*
+ * This function caches the lease bound by the DHCP client of a STA interface and saves the
+ * cache if it changed. Must be called with the TCP/IP core lock held.
+ */
+static void dhcp_lease_update(nw_interface_entry_t *nw_interface)
+{
+    struct netif *netif = &nw_interface->netif;
+    struct dhcp *dhcp = netif_dhcp_data(netif);
+    cy_lwip_dhcp_lease_t lease;
+    int index;
+
+    if ((nw_interface->lease_key.ssid_len == 0) || (dhcp == NULL) || (dhcp->state != DHCP_STATE_BOUND))
+    {
+        return;
+    }
+
+    lease            = nw_interface->lease_key;
+    lease.ip_addr    = ip4_addr_get_u32(netif_ip4_addr(netif));
+    lease.netmask    = ip4_addr_get_u32(netif_ip4_netmask(netif));
+    lease.gateway    = ip4_addr_get_u32(netif_ip4_gw(netif));
+    lease.lease_time = dhcp->offered_t0_lease;
+    lease.obtained   = dhcp_lease_now();
+
+    index = dhcp_lease_find(&lease);
+    if ((index == 0) && (dhcp_lease_cache[0].ip_addr == lease.ip_addr) && (dhcp_lease_cache[0].netmask == lease.netmask) &&
+        (dhcp_lease_cache[0].gateway == lease.gateway) && (dhcp_lease_cache[0].lease_time == lease.lease_time))
+    {
+        /* Same lease bound again: only its start moves, the saved copy stays on the safe side */
+        dhcp_lease_cache[0].obtained = lease.obtained;
+        return;
+    }
+
+    /* Move the lease to the front, evicting the least recently used one if the cache is full */
+    if (index < 0)
+    {
+        if (dhcp_lease_count < CY_LWIP_DHCP_LEASE_CACHE_SIZE)
+        {
+            dhcp_lease_count++;
+        }
+        index = (int)dhcp_lease_count - 1;
+    }
+    memmove(&dhcp_lease_cache[1], &dhcp_lease_cache[0], (uint32_t)index * sizeof(dhcp_lease_cache[0]));
+    dhcp_lease_cache[0] = lease;
+
+    if (dhcp_lease_config.save != NULL)
+    {
+        dhcp_lease_config.save(dhcp_lease_cache, dhcp_lease_count, dhcp_lease_config.arg);
+    }
+}
+
+cy_rslt_t cy_lwip_dhcp_lease_cache_configure(const cy_lwip_dhcp_lease_cache_config_t *config)
+{
+    cy_lwip_dhcp_lease_t leases[CY_LWIP_DHCP_LEASE_CACHE_SIZE];
+    uint32_t count = 0;
+    uint32_t i;
+    cy_rslt_t result;
+
+    if (config == NULL)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    /* Storage is read without the TCP/IP core lock held */
+    if (config->load != NULL)
+    {
+        memset(leases, 0, sizeof(leases));
+        result = config->load(leases, CY_LWIP_DHCP_LEASE_CACHE_SIZE, &count, config->arg);
+        if (result != CY_RSLT_SUCCESS)
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to load the DHCP lease cache \n");
+            return result;
+        }
+        if (count > CY_LWIP_DHCP_LEASE_CACHE_SIZE)
+        {
+            count = CY_LWIP_DHCP_LEASE_CACHE_SIZE;
+        }
+        for (i = 0; i < count; i++)
+        {
+            if (leases[i].ssid_len > sizeof(leases[i].ssid))
+            {
+                leases[i].ssid_len = sizeof(leases[i].ssid);
+            }
+        }
+    }
+
+    LOCK_TCPIP_CORE();
+    if (config->get_time != dhcp_lease_config.get_time)
+    {
+        /* The cached leases are stamped with another clock */
+        dhcp_lease_count = 0;
+    }
+    dhcp_lease_config = *config;
+    if (config->load != NULL)
+    {
+        /* Without a clock which keeps running across resets, the age of the restored leases is unknown */
+        if (config->get_time == NULL)
+        {
+            count = 0;
+        }
+        memcpy(dhcp_lease_cache, leases, count * sizeof(leases[0]));
+        dhcp_lease_count = count;
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_lwip_dhcp_lease_cache_clear(void)
+{
+    LOCK_TCPIP_CORE();
+    dhcp_lease_count = 0;
+    if (dhcp_lease_config.save != NULL)
+    {
+        dhcp_lease_config.save(dhcp_lease_cache, 0, dhcp_lease_config.arg);
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS;
+}
+#elif LWIP_IPV4
+cy_rslt_t cy_lwip_dhcp_lease_cache_configure(const cy_lwip_dhcp_lease_cache_config_t *config)
+{
+    (void)config;
+    return CY_RSLT_LWIP_DHCP_LEASE_CACHE_DISABLED;
+}
+
+cy_rslt_t cy_lwip_dhcp_lease_cache_clear(void)
+{
+    return CY_RSLT_LWIP_DHCP_LEASE_CACHE_DISABLED;
+}
+#endif /* DHCP_LEASE_CACHE */
+
+#if GATEWAY_ARP_PRESEED
+/*
+ * This function remembers the sender of the DHCP replies received on a DHCP client interface.
+ * The reply comes from the DHCP server, or from a relay agent which is then the gateway, so
+ * its source MAC address is the one of the gateway whenever its source IP address is.
+ * Runs in the WHD receive thread, on the raw ethernet frame.
+ */
+static void gateway_arp_capture(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length)
+{
+    const uint8_t *ip_header = data + ETHERNET_HEADER_LENGTH;
+    const uint8_t *udp_header;
+    uint16_t ip_header_length;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (length < (ETHERNET_HEADER_LENGTH + IPV4_MIN_HEADER_LENGTH))
+    {
+        return;
+    }
+
+    ip_header_length = (uint16_t)((ip_header[0] & 0x0F) * 4);
+    if ((ip_header[9] != IP_PROTOCOL_UDP) || (ip_header_length < IPV4_MIN_HEADER_LENGTH) ||
+        (length < (ETHERNET_HEADER_LENGTH + ip_header_length + 4)))
+    {
+        return;
+    }
+
+    udp_header = ip_header + ip_header_length;
+    if ((((udp_header[0] << 8) | udp_header[1]) != DHCP_SERVER_UDP_PORT) ||
+        (((udp_header[2] << 8) | udp_header[3]) != DHCP_CLIENT_UDP_PORT))
+    {
+        return;
+    }
+
+    /* Source MAC and IP address are written together, gateway_arp_preseed() reads them on the TCP/IP thread */
+    SYS_ARCH_PROTECT(lev);
+    memcpy(nw_interface->dhcp_server_hwaddr.addr, data + 6, ETH_HWADDR_LEN);
+    nw_interface->dhcp_server_ip = (uint32_t)ip_header[12] | ((uint32_t)ip_header[13] << 8) |
+                                   ((uint32_t)ip_header[14] << 16) | ((uint32_t)ip_header[15] << 24);
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/*
+ * This function removes the static ARP entry installed for the gateway, if any.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void gateway_arp_remove(nw_interface_entry_t *nw_interface)
+{
+    if (!ip4_addr_isany_val(nw_interface->preseeded_gw))
+    {
+        etharp_remove_static_entry(&nw_interface->preseeded_gw);
+        ip4_addr_set_any(&nw_interface->preseeded_gw);
+    }
+}
+
+/*
+ * This function installs the MAC address of the gateway as a static ARP entry once DHCP
+ * binds, so that the first packet routed through it is not held back by an ARP exchange.
+ * This is only done when the gateway is the host which sent the DHCP replies.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void gateway_arp_preseed(nw_interface_entry_t *nw_interface)
+{
+    struct netif *netif = &nw_interface->netif;
+    const ip4_addr_t *gw = netif_ip4_gw(netif);
+    struct eth_addr server_hwaddr;
+    uint32_t server_ip;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (ip4_addr_cmp(&nw_interface->preseeded_gw, gw))
+    {
+        return;
+    }
+    gateway_arp_remove(nw_interface);
+
+    /* Copy out under the same protection gateway_arp_capture() writes with, so the MAC is never half updated */
+    SYS_ARCH_PROTECT(lev);
+    server_hwaddr = nw_interface->dhcp_server_hwaddr;
+    server_ip     = nw_interface->dhcp_server_ip;
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (!dhcp_supplied_address(netif) || ip4_addr_isany(gw) || (ip4_addr_get_u32(gw) != server_ip))
+    {
+        return;
+    }
+
+    if (etharp_add_static_entry(gw, &server_hwaddr) == ERR_OK)
+    {
+        ip4_addr_copy(nw_interface->preseeded_gw, *gw);
+    }
+}
+#endif /* GATEWAY_ARP_PRESEED */
+
+#if IPV6_ANNOUNCE
+/*
+ * This function announces an IPv6 address of the interface with an unsolicited neighbor
+ * advertisement to all nodes, so that they update their neighbor cache right away.
+ */
+static void announce_ipv6_address(struct netif *netif, s8_t index)
+{
+    struct pbuf *p;
+    struct na_header *na_hdr;
+    struct lladdr_option *lladdr_opt;
+    const ip6_addr_t *src = netif_ip6_addr(netif, index);
+    ip6_addr_t dest;
+    u16_t lladdr_opt_len = (u16_t)(((netif->hwaddr_len + 2) + 7) >> 3);
+
+    p = pbuf_alloc(PBUF_IP, (u16_t)(sizeof(struct na_header) + (lladdr_opt_len << 3)), PBUF_RAM);
+    if (p == NULL)
+    {
+        return;
+    }
+    memset(p->payload, 0, p->len);
+
+    na_hdr = (struct na_header *)p->payload;
+    na_hdr->type  = ICMP6_TYPE_NA;
+    na_hdr->flags = ND6_FLAG_OVERRIDE;
+    ip6_addr_copy_to_packed(na_hdr->target_address, *src);
+
+    lladdr_opt = (struct lladdr_option *)((u8_t *)p->payload + sizeof(struct na_header));
+    lladdr_opt->type   = ND6_OPTION_TYPE_TARGET_LLADDR;
+    lladdr_opt->length = (u8_t)lladdr_opt_len;
+    SMEMCPY(lladdr_opt->addr, netif->hwaddr, netif->hwaddr_len);
+
+    ip6_addr_set_allnodes_linklocal(&dest);
+    ip6_addr_assign_zone(&dest, IP6_MULTICAST, netif);
+
+#if CHECKSUM_GEN_ICMP6
+    na_hdr->chksum = ip6_chksum_pseudo(p, IP6_NEXTH_ICMP6, p->len, src, &dest);
+#endif
+
+    ip6_output_if(p, src, &dest, ND6_MESSAGE_HOP_LIMIT, 0, IP6_NEXTH_ICMP6, netif);
+    pbuf_free(p);
+}
+#endif /* IPV6_ANNOUNCE */
+
+#if OPTIMISTIC_DAD
+/*
+ * This function sends a duplicate address detection probe for an optimistic address: a
+ * neighbor solicitation from the unspecified address to the solicited-node multicast address
+ * of the target. The neighbor advertisement of a node defending the address is handled by
+ * LwIP, which marks the address as duplicated.
+ */
+static void optimistic_dad_send_probe(struct netif *netif, const ip6_addr_t *target)
+{
+    struct pbuf *p;
+    struct ns_header *ns_hdr;
+    ip6_addr_t dest;
+
+    p = pbuf_alloc(PBUF_IP, sizeof(struct ns_header), PBUF_RAM);
+    if (p == NULL)
+    {
+        return;
+    }
+
+    ns_hdr = (struct ns_header *)p->payload;
+    ns_hdr->type     = ICMP6_TYPE_NS;
+    ns_hdr->code     = 0;
+    ns_hdr->chksum   = 0;
+    ns_hdr->reserved = 0;
+    ip6_addr_copy_to_packed(ns_hdr->target_address, *target);
+
+    ip6_addr_set_solicitednode(&dest, target->addr[3]);
+    ip6_addr_assign_zone(&dest, IP6_MULTICAST, netif);
+
+#if CHECKSUM_GEN_ICMP6
+    ns_hdr->chksum = ip6_chksum_pseudo(p, IP6_NEXTH_ICMP6, p->len, IP6_ADDR_ANY6, &dest);
+#endif
+
+    /* A NULL source makes LwIP send from the unspecified address */
+    ip6_output_if(p, NULL, &dest, ND6_MESSAGE_HOP_LIMIT, 0, IP6_NEXTH_ICMP6, netif);
+    pbuf_free(p);
+}
+
+/*
+ * This function returns the index of the optimistic address of an interface, still being
+ * probed, which the given packed address is, or -1.
+ */
+static s8_t optimistic_dad_find(nw_interface_entry_t *nw_interface, const uint8_t *addr)
+{
+    s8_t i;
+
+    for (i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++)
+    {
+        if ((nw_interface->dad_probes[i] != 0) &&
+            (memcmp(addr, netif_ip6_addr(&nw_interface->netif, i)->addr, sizeof(ip6_addr_p_t)) == 0))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * This function marks as duplicated the optimistic addresses another node was found probing
+ * by optimistic_dad_rx_conflict(). Must be called with the TCP/IP core lock held.
+ */
+static void optimistic_dad_mark_conflicts(nw_interface_entry_t *nw_interface)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    uint8_t conflicts;
+    s8_t i;
+
+    SYS_ARCH_PROTECT(lev);
+    conflicts = nw_interface->dad_conflicts;
+    nw_interface->dad_conflicts = 0;
+    SYS_ARCH_UNPROTECT(lev);
+
+    for (i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++)
+    {
+        if ((conflicts & (1 << i)) && (nw_interface->dad_probes[i] != 0))
+        {
+            /* The state change callback logs the conflict and stops the probes */
+            netif_ip6_addr_set_state(&nw_interface->netif, i, IP6_ADDR_DUPLICATED);
+        }
+    }
+}
+
+/*
+ * This function runs optimistic_dad_mark_conflicts() in the TCP/IP thread.
+ */
+static void optimistic_dad_conflict_callback(void *arg)
+{
+    optimistic_dad_mark_conflicts((nw_interface_entry_t *)arg);
+}
+
+/*
+ * This function checks whether a received frame is a duplicate address detection probe of
+ * another node, a neighbor solicitation from the unspecified address, for an address this
+ * interface is still probing. The address is then a duplicate (RFC 4429): it is marked as
+ * such from the TCP/IP thread, and the probe must not reach LwIP, which would defend the
+ * address with an advertisement. Runs in the WHD thread.
+ */
+static bool optimistic_dad_rx_conflict(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    const uint8_t *ip6 = data + ETHERNET_HEADER_LENGTH;
+    const uint8_t *icmp6 = data + ND6_FRAME_ICMP6_OFFSET;
+    s8_t index;
+    int i;
+
+    if ((length < ND6_FRAME_ICMP6_OFFSET + sizeof(struct ns_header)) ||
+        (ip6[6] != IP6_NEXTH_ICMP6) || (icmp6[0] != ICMP6_TYPE_NS))
+    {
+        return false;
+    }
+
+    /* Source address, unspecified for a probe */
+    for (i = 8; i < 24; i++)
+    {
+        if (ip6[i] != 0)
+        {
+            return false;
+        }
+    }
+
+    index = optimistic_dad_find(nw_interface, icmp6 + offsetof(struct ns_header, target_address));
+    if (index < 0)
+    {
+        return false;
+    }
+
+    SYS_ARCH_PROTECT(lev);
+    nw_interface->dad_conflicts |= (uint8_t)(1 << index);
+    SYS_ARCH_UNPROTECT(lev);
+    /* Should the TCP/IP mailbox be full, the conflict is marked before the next probe */
+    tcpip_try_callback(optimistic_dad_conflict_callback, nw_interface);
+    return true;
+}
+
+/*
+ * This function applies the restrictions of RFC 4429 to an outgoing neighbor discovery
+ * message about an address still being probed: the Override flag of a neighbor advertisement
+ * for the address is cleared, and the source link-layer address option LwIP appends to a
+ * router or neighbor solicitation sent from the address is removed. The message is a PBUF_RAM
+ * pbuf LwIP allocated for it. Must be called with the TCP/IP core lock held.
+ */
+static void optimistic_dad_tx_restrict(whd_interface_t whd_iface, struct pbuf *p)
+{
+    uint8_t *ip6 = (uint8_t *)p->payload + ETHERNET_HEADER_LENGTH;
+    uint8_t *icmp6 = (uint8_t *)p->payload + ND6_FRAME_ICMP6_OFFSET;
+    nw_interface_entry_t *nw_interface;
+    const uint8_t *addr;
+    uint16_t fixed_length;
+    uint16_t icmp6_length;
+#if CHECKSUM_GEN_ICMP6
+    uint32_t sum;
+    ip6_addr_t src;
+    ip6_addr_t dest;
+    u16_t chksum;
+#endif
+
+    if ((p->next != NULL) || (p->len < ND6_FRAME_ICMP6_OFFSET + sizeof(struct rs_header)) ||
+        (((uint8_t *)p->payload)[12] != (ETHTYPE_IPV6 >> 8)) || (((uint8_t *)p->payload)[13] != (ETHTYPE_IPV6 & 0xFF)) ||
+        (ip6[6] != IP6_NEXTH_ICMP6))
+    {
+        return;
+    }
+
+    switch (icmp6[0])
+    {
+        case ICMP6_TYPE_NA:
+            if (p->len < ND6_FRAME_ICMP6_OFFSET + sizeof(struct na_header))
+            {
+                return;
+            }
+            addr = icmp6 + offsetof(struct na_header, target_address);
+            fixed_length = 0;
+            break;
+        case ICMP6_TYPE_NS:
+            addr = ip6 + 8;
+            fixed_length = sizeof(struct ns_header);
+            break;
+        case ICMP6_TYPE_RS:
+            addr = ip6 + 8;
+            fixed_length = sizeof(struct rs_header);
+            break;
+        default:
+            return;
+    }
+
+    nw_interface = find_nw_interface(whd_iface);
+    if ((nw_interface == NULL) || (optimistic_dad_find(nw_interface, addr) < 0))
+    {
+        return;
+    }
+
+    if (icmp6[0] == ICMP6_TYPE_NA)
+    {
+        if ((icmp6[4] & ND6_FLAG_OVERRIDE) == 0)
+        {
+            return;
+        }
+#if CHECKSUM_GEN_ICMP6
+        /* The flags are the high byte of the third 16-bit word, the checksum is updated as in RFC 1624 */
+        sum = (uint16_t)~((icmp6[2] << 8) | icmp6[3]);
+        sum += (uint16_t)~((icmp6[4] << 8) | icmp6[5]);
+        icmp6[4] &= (uint8_t)~ND6_FLAG_OVERRIDE;
+        sum += (uint16_t)((icmp6[4] << 8) | icmp6[5]);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        icmp6[2] = (uint8_t)(~sum >> 8);
+        icmp6[3] = (uint8_t)~sum;
+#else
+        icmp6[4] &= (uint8_t)~ND6_FLAG_OVERRIDE;
+#endif
+        return;
+    }
+
+    /* LwIP sends the source link-layer address option alone, after the fixed part */
+    icmp6_length = (uint16_t)((ip6[4] << 8) | ip6[5]);
+    if ((icmp6_length <= fixed_length) || (p->len < ND6_FRAME_ICMP6_OFFSET + icmp6_length) ||
+        (icmp6[fixed_length] != ND6_OPTION_TYPE_SOURCE_LLADDR) ||
+        ((uint16_t)(icmp6[fixed_length + 1] << 3) != (icmp6_length - fixed_length)))
+    {
+        return;
+    }
+
+    ip6[4] = (uint8_t)(fixed_length >> 8);
+    ip6[5] = (uint8_t)fixed_length;
+    pbuf_realloc(p, (u16_t)(ND6_FRAME_ICMP6_OFFSET + fixed_length));
+
+#if CHECKSUM_GEN_ICMP6
+    icmp6[2] = 0;
+    icmp6[3] = 0;
+    ip6_addr_copy_from_packed(src, *(const ip6_addr_p_t *)(ip6 + 8));
+    ip6_addr_copy_from_packed(dest, *(const ip6_addr_p_t *)(ip6 + 24));
+    pbuf_remove_header(p, ND6_FRAME_ICMP6_OFFSET);
+    chksum = ip6_chksum_pseudo(p, IP6_NEXTH_ICMP6, p->len, &src, &dest);
+    pbuf_add_header(p, ND6_FRAME_ICMP6_OFFSET);
+    memcpy(icmp6 + 2, &chksum, sizeof(chksum));
+#endif
+}
+
+/*
+ * This function probes the optimistic addresses of an interface, once per
+ * OPTIMISTIC_DAD_PROBE_INTERVAL_MS, until LWIP_IPV6_DUP_DETECT_ATTEMPTS probes were sent
+ * for each of them. It runs in the TCP/IP thread.
+ */
+static void optimistic_dad_timer(void *arg)
+{
+    nw_interface_entry_t *nw_interface = (nw_interface_entry_t *)arg;
+    struct netif *netif = &nw_interface->netif;
+    bool pending = false;
+    s8_t i;
+
+    /* Conflicts whose callback could not be posted */
+    optimistic_dad_mark_conflicts(nw_interface);
+
+    for (i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++)
+    {
+        if (nw_interface->dad_probes[i] == 0)
+        {
+            continue;
+        }
+        if (!ip6_addr_isvalid(netif_ip6_addr_state(netif, i)))
+        {
+            /* Address removed or found duplicated */
+            nw_interface->dad_probes[i] = 0;
+            continue;
+        }
+        optimistic_dad_send_probe(netif, netif_ip6_addr(netif, i));
+        if (--nw_interface->dad_probes[i] != 0)
+        {
+            pending = true;
+        }
+#if IPV6_ANNOUNCE
+        else
+        {
+            /* No conflict was reported: the address is now announced like any other */
+            announce_ipv6_address(netif, i);
+        }
+#endif
+    }
+
+    if (pending)
+    {
+        sys_timeout(OPTIMISTIC_DAD_PROBE_INTERVAL_MS, optimistic_dad_timer, nw_interface);
+    }
+}
+
+/*
+ * This function makes the tentative addresses of an interface usable right away, taking
+ * over their duplicate address detection from LwIP. Nothing is done until the link is up.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void optimistic_dad_start(nw_interface_entry_t *nw_interface)
+{
+    struct netif *netif = &nw_interface->netif;
+    bool started = false;
+    s8_t i;
+
+    if (!netif_is_up(netif) || !netif_is_link_up(netif))
+    {
+        return;
+    }
+
+    for (i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++)
+    {
+        if (!ip6_addr_istentative(netif_ip6_addr_state(netif, i)))
+        {
+            continue;
+        }
+        nw_interface->dad_probes[i] = LWIP_IPV6_DUP_DETECT_ATTEMPTS;
+        netif_ip6_addr_set_state(netif, i, IP6_ADDR_PREFERRED);
+        started = true;
+    }
+
+    if (started)
+    {
+        /* The first probe is sent right away */
+        sys_untimeout(optimistic_dad_timer, nw_interface);
+        optimistic_dad_timer(nw_interface);
+    }
+}
+#endif /* OPTIMISTIC_DAD */
+
+/*
+ * This function completes an asynchronous network bring-up and reports the result to the caller.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void nw_up_complete(nw_interface_entry_t *nw_interface, cy_rslt_t result)
+{
+    cy_lwip_network_up_params_t params = nw_interface->up_params;
+
+    /* The acquisition of the families not waited for, if still running, is left to LwIP */
+    sys_untimeout(nw_up_timeout, nw_interface);
+#if LWIP_IPV4 && LWIP_AUTOIP
+    sys_untimeout(nw_up_autoip_poll, nw_interface);
+#endif
+    nw_interface->up_state = NW_UP_STATE_IDLE;
+    nw_interface->up_wait  = 0;
+    if (result == CY_RSLT_SUCCESS)
+    {
+        nw_interface->is_up = true;
+    }
+#if CY_LWIP_PHASE_TIMING
+    phase_timing_finish(&nw_interface->up_timing, result);
+#endif
+
+    if (params.callback != NULL)
+    {
+        params.callback(&nw_interface->up_iface, result, params.arg);
+    }
+}
+
+/*
+ * This function starts the IPv4 part of an asynchronous network bring-up: DHCP for a STA
+ * interface without static IP address, nothing otherwise. It is called before the link is
+ * brought up, so that the DHCP client sends its first message from dhcp_network_changed().
+ * Must be called with the TCP/IP core lock held.
+ */
+static cy_rslt_t nw_up_start_ipv4(nw_interface_entry_t *nw_interface)
+{
+#if LWIP_IPV4
+    ip4_addr_t ip_addr;
+
+    if (nw_interface->is_dhcp_client_required)
+    {
+        /* TO DO :  Save the current power save state */
+        /* TO DO :  Disable power save for the DHCP exchange */
+
+        /*
+         * For DHCP only, we should reset netif IP address
+         * We don't want to re-use previous netif IP address
+         * given from previous DHCP session
+         */
+        ip4_addr_set_zero(&ip_addr);
+        netif_set_ipaddr(&nw_interface->netif, &ip_addr);
+
+        /* TO DO : DHCPV6 need to be handled when we support IPV6 addresses other than the link local address */
+        /* Start DHCP */
+        PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP);
+        if (dhcp_start(&nw_interface->netif) != ERR_OK)
+        {
+            return CY_RSLT_LWIP_ERROR_STARTING_DHCP;
+        }
+
+#if DHCP_LEASE_CACHE
+        if (dhcp_lease_reboot(nw_interface))
+        {
+            /* The cached address is used while the DHCP server verifies it */
+            PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP);
+#if CY_LWIP_PHASE_TIMING
+            nw_interface->up_timing.dhcp_lease_cached = true;
+#endif
+            return CY_RSLT_SUCCESS;
+        }
+#endif
+
+        /* Progress is reported by nw_up_advance() once DHCP binds, or by nw_up_timeout() */
+        nw_interface->up_state = NW_UP_STATE_WAIT_DHCP;
+        sys_timeout(DHCP_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS, nw_up_timeout, nw_interface);
+    }
+#else
+    (void)nw_interface;
+#endif
+    return CY_RSLT_SUCCESS;
+}
+
+/*
+ * This function moves an asynchronous network bring-up forward. It is invoked when the
+ * bring-up starts and whenever an address of the interface changes state. The IPv4 and
+ * IPv6 acquisitions are tracked independently; the bring-up completes once every family
+ * in up_wait is usable.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void nw_up_advance(nw_interface_entry_t *nw_interface)
+{
+    struct netif *netif = &nw_interface->netif;
+
+#if LWIP_IPV6
+    /* Wait for IPV6 address to change from tentative to valid or invalid */
+    if ((nw_interface->up_wait & CY_LWIP_NETWORK_UP_WAIT_IPV6) &&
+        !ip6_addr_istentative(netif_ip6_addr_state(netif, 0)))
+    {
+        /* LWIP changes state to either INVALID or VALID. Check if the state is VALID */
+        if (ip6_addr_isvalid(netif_ip6_addr_state(netif, 0)))
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "IPv6 Network ready IP: %s \r\n", ip6addr_ntoa(netif_ip6_addr(netif, 0)));
+        }
+        else
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "IPv6 network not ready \r\n");
+        }
+        nw_interface->up_wait &= (uint8_t)~CY_LWIP_NETWORK_UP_WAIT_IPV6;
+        PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_IPV6_DAD);
+    }
+#endif
+
+#if LWIP_IPV4
+    switch (nw_interface->up_state)
+    {
+        case NW_UP_STATE_WAIT_DHCP:
+            if (netif_dhcp_data(netif)->state != DHCP_STATE_BOUND)
+            {
+                break;
+            }
+            PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP);
+            sys_untimeout(nw_up_timeout, nw_interface);
+            nw_interface->up_state = NW_UP_STATE_IDLE;
+            break;
+
+#if LWIP_AUTOIP
+        case NW_UP_STATE_WAIT_AUTOIP:
+            if (netif_autoip_data(netif)->state != AUTOIP_STATE_BOUND)
+            {
+                /* The address is assigned when AutoIP starts announcing it, but the move to
+                 * BOUND changes nothing on the interface, so it is polled for from then on */
+                if (netif_autoip_data(netif)->state == AUTOIP_STATE_ANNOUNCING)
+                {
+                    sys_untimeout(nw_up_autoip_poll, nw_interface);
+                    sys_timeout(AUTO_IP_BOUND_POLL_INTERVAL_MS, nw_up_autoip_poll, nw_interface);
+                }
+                break;
+            }
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "IP address obtained through AutoIP \n");
+            PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_AUTOIP);
+            sys_untimeout(nw_up_timeout, nw_interface);
+            sys_untimeout(nw_up_autoip_poll, nw_interface);
+            nw_interface->up_state = NW_UP_STATE_IDLE;
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    /* A static address, or one obtained through DHCP or AutoIP, is usable right away */
+    if (nw_interface->up_state == NW_UP_STATE_IDLE)
+    {
+        nw_interface->up_wait &= (uint8_t)~CY_LWIP_NETWORK_UP_WAIT_IPV4;
+    }
+#endif
+
+    if (nw_interface->up_wait == 0)
+    {
+        nw_up_complete(nw_interface, CY_RSLT_SUCCESS);
+    }
+}
+
+#if LWIP_IPV4
+/*
+ * This function ends the IPv4 acquisition of an asynchronous network bring-up after
+ * DHCP, and AutoIP if enabled, failed to obtain an address.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void nw_up_ipv4_failed(nw_interface_entry_t *nw_interface)
+{
+#if LWIP_AUTOIP
+    sys_untimeout(nw_up_autoip_poll, nw_interface);
+#endif
+    nw_interface->up_state = NW_UP_STATE_IDLE;
+    if (nw_interface->up_wait & CY_LWIP_NETWORK_UP_WAIT_IPV4)
+    {
+        nw_up_complete(nw_interface, CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT);
+    }
+}
+
+#if LWIP_AUTOIP
+/*
+ * This function checks whether the link-local address announced by AutoIP is bound.
+ * It runs in the TCP/IP thread.
+ */
+static void nw_up_autoip_poll(void *arg)
+{
+    nw_interface_entry_t *nw_interface = (nw_interface_entry_t *)arg;
+
+    if (nw_interface->up_state == NW_UP_STATE_WAIT_AUTOIP)
+    {
+        nw_up_advance(nw_interface);
+    }
+}
+#endif
+#endif
+
+/*
+ * This function handles the expiry of the DHCP and AutoIP address resolution timeouts
+ * of an asynchronous network bring-up. It runs in the TCP/IP thread. A failure to obtain
+ * an IPv4 address fails the bring-up only if the caller waits for IPv4.
+ */
+static void nw_up_timeout(void *arg)
+{
+    nw_interface_entry_t *nw_interface = (nw_interface_entry_t *)arg;
+    struct netif *netif = &nw_interface->netif;
+
+#if LWIP_IPV4
+    if (nw_interface->up_state == NW_UP_STATE_WAIT_DHCP)
+    {
+        dhcp_release_and_stop(netif);
+        PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP);
+#if LWIP_AUTOIP
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "Unable to obtain IP address via DHCP. Perform Auto IP\n");
+        PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_AUTOIP);
+        nw_interface->up_state     = NW_UP_STATE_WAIT_AUTOIP;
+        nw_interface->autoip_tries = 0;
+        if (autoip_start(netif) != ERR_OK)
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to obtain IP address via DCHP and AutoIP\n");
+            autoip_stop(netif);
+            nw_up_ipv4_failed(nw_interface);
+            return;
+        }
+        sys_timeout(AUTO_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS, nw_up_timeout, nw_interface);
+#else
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to obtain IP address via DHCP\n");
+        nw_up_ipv4_failed(nw_interface);
+#endif
+        return;
+    }
+
+#if LWIP_AUTOIP
+    if (nw_interface->up_state == NW_UP_STATE_WAIT_AUTOIP)
+    {
+        if (nw_interface->autoip_tries++ < MAX_AUTO_IP_RETRIES)
+        {
+            sys_timeout(AUTO_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS, nw_up_timeout, nw_interface);
+            return;
+        }
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to obtain IP address via DCHP and AutoIP\n");
+        autoip_stop(netif);
+        PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_AUTOIP);
+        nw_up_ipv4_failed(nw_interface);
+    }
+#endif
+#else
+    (void)netif;
+#endif
+}
+
+/*
+ * This function is invoked by LwIP whenever the state of a network interface changes.
+ * It reports the change to the IP change callbacks and drives the asynchronous network
+ * bring-ups in progress.
+ */
+static void nw_interface_ext_callback(struct netif *netif, netif_nsc_reason_t reason, const netif_ext_callback_args_t *args)
+{
+    nw_interface_entry_t *nw_interface = find_nw_interface((whd_interface_t)netif->state);
+
+    (void)args;
+
+    if ((nw_interface == NULL) || (&nw_interface->netif != netif))
+    {
+        return;
+    }
+
+#if DHCP_LEASE_CACHE
+    if (reason & (LWIP_NSC_IPV4_SETTINGS_CHANGED | LWIP_NSC_IPV4_ADDRESS_CHANGED))
+    {
+        dhcp_lease_update(nw_interface);
+    }
+#endif
+
+#if OPTIMISTIC_DAD
+    if (reason & LWIP_NSC_IPV6_ADDR_STATE_CHANGED)
+    {
+        s8_t index = args->ipv6_addr_state_changed.addr_index;
+
+        if (ip6_addr_istentative(netif_ip6_addr_state(netif, index)))
+        {
+            /* New SLAAC address, or DAD restarted by LwIP when the link came back up */
+            optimistic_dad_start(nw_interface);
+        }
+        else if (ip6_addr_isduplicated(netif_ip6_addr_state(netif, index)) &&
+                 ip6_addr_isvalid(args->ipv6_addr_state_changed.old_state))
+        {
+            /* The conflict reaches the IP change callbacks through ip_change_notify() */
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "IPv6 address %s is used by another node \n", ip6addr_ntoa(netif_ip6_addr(netif, index)));
+            nw_interface->dad_probes[index] = 0;
+        }
+    }
+#endif
+
+#if GATEWAY_ARP_PRESEED
+    if (reason & (LWIP_NSC_IPV4_SETTINGS_CHANGED | LWIP_NSC_IPV4_ADDRESS_CHANGED | LWIP_NSC_IPV4_GATEWAY_CHANGED))
+    {
+        gateway_arp_preseed(nw_interface);
+    }
+#endif
+
+#if IPV6_ANNOUNCE
+    if ((reason & LWIP_NSC_IPV6_ADDR_STATE_CHANGED) &&
+        !ip6_addr_isvalid(args->ipv6_addr_state_changed.old_state) &&
+        ip6_addr_isvalid(netif_ip6_addr_state(netif, args->ipv6_addr_state_changed.addr_index)))
+    {
+#if OPTIMISTIC_DAD
+        /* Optimistic addresses are announced once their probes are done */
+        if (nw_interface->dad_probes[args->ipv6_addr_state_changed.addr_index] == 0)
+#endif
+        {
+            announce_ipv6_address(netif, args->ipv6_addr_state_changed.addr_index);
+        }
+    }
+#endif
+
+    ip_change_notify(nw_interface, reason, args);
+
+    if (nw_interface->up_wait == 0)
+    {
+        return;
+    }
+
+    if (reason & (LWIP_NSC_IPV4_SETTINGS_CHANGED | LWIP_NSC_IPV4_ADDRESS_CHANGED | LWIP_NSC_IPV6_ADDR_STATE_CHANGED))
+    {
+        nw_up_advance(nw_interface);
+    }
+}
+
+/*
+ * This function brings up the network interface and starts the address acquisition,
+ * then returns. The state machine is driven by LwIP interface events from then on.
+ */
+cy_rslt_t cy_lwip_network_up_async(cy_lwip_nw_interface_t *iface, const cy_lwip_network_up_params_t *params)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    nw_interface_entry_t *nw_interface;
+    uint8_t wait_for;
+
+    if((is_interface_valid(iface) != CY_RSLT_SUCCESS) || (params == NULL))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    wait_for = (params->wait_for == 0) ? CY_LWIP_NETWORK_UP_WAIT_ALL : params->wait_for;
+#if !LWIP_IPV4
+    wait_for &= (uint8_t)~CY_LWIP_NETWORK_UP_WAIT_IPV4;
+#endif
+#if !LWIP_IPV6
+    wait_for &= (uint8_t)~CY_LWIP_NETWORK_UP_WAIT_IPV6;
+#endif
+    if(wait_for == 0)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error Interface doesn't exist \n");
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
+    }
+
+    if(nw_interface->up_wait != 0)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Network bring up is already in progress \n");
+        return CY_RSLT_LWIP_NETWORK_UP_IN_PROGRESS;
+    }
+
+#if CY_LWIP_PHASE_TIMING
+    phase_timing_start(&nw_interface->up_timing, CY_LWIP_PHASE_OP_NETWORK_UP, iface->role);
+#endif
+
+    /*
+     * If LPA is enabled, invoke activity callback to resume the network stack,
+     * before invoking the lwip APIs that requires TCP Core lock.
+     */
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+    if(nw_interface->is_up)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "Network is already up \n");
+        LOCK_TCPIP_CORE();
+        nw_interface->up_iface  = *iface;
+        nw_interface->up_params = *params;
+        nw_up_complete(nw_interface, CY_RSLT_SUCCESS);
+        UNLOCK_TCPIP_CORE();
+        return CY_RSLT_SUCCESS;
+    }
+
+    /*
+    * Bring up the network interface.
+    */
+    PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_NETIF_UP);
+    netifapi_netif_set_up(&nw_interface->netif);
+    PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_NETIF_UP);
+
+#if DHCP_LEASE_CACHE
+    if(nw_interface->is_dhcp_client_required)
+    {
+        dhcp_lease_get_key(nw_interface);
+    }
+#endif
+
+#if LWIP_IPV4
+    if(iface->role == CY_LWIP_AP_NW_INTERFACE)
+    {
+        memset(&nw_interface->dhcp_server, 0, sizeof(nw_interface->dhcp_server));
+        nw_interface->dhcp_server.config = nw_interface->dhcp_server_config;
+        nw_interface->dhcp_server.netif  = &nw_interface->netif;
+        igmp_start(&nw_interface->netif);
+        /* Start internal DHCP server */
+        PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP_SERVER_START);
+        if((result = cy_lwip_dhcp_server_start(&nw_interface->dhcp_server, iface->role))!= CY_RSLT_SUCCESS)
+        {
+#if CY_LWIP_PHASE_TIMING
+            LOCK_TCPIP_CORE();
+            phase_timing_finish(&nw_interface->up_timing, CY_RSLT_LWIP_ERROR_STARTING_DHCP);
+            UNLOCK_TCPIP_CORE();
+#endif
+            return CY_RSLT_LWIP_ERROR_STARTING_DHCP;
+        }
+        PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_DHCP_SERVER_START);
+    }
+#endif
+
+    LOCK_TCPIP_CORE();
+    nw_interface->up_iface  = *iface;
+    nw_interface->up_params = *params;
+    nw_interface->up_wait   = wait_for;
+    /* DHCP is started right away, while the IPv6 link-local address is still tentative */
+    result = nw_up_start_ipv4(nw_interface);
+
+    /*
+    * Bring up the network link layer
+    */
+    PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_LINK_UP);
+    netif_set_link_up(&nw_interface->netif);
+    PHASE_END(&nw_interface->up_timing, CY_LWIP_PHASE_LINK_UP);
+#if LWIP_IPV6
+    PHASE_BEGIN(&nw_interface->up_timing, CY_LWIP_PHASE_IPV6_DAD);
+#endif
+#if OPTIMISTIC_DAD
+    optimistic_dad_start(nw_interface);
+#endif
+
+    if(result != CY_RSLT_SUCCESS)
+    {
+        nw_up_complete(nw_interface, result);
+    }
+    else
+    {
+        nw_up_advance(nw_interface);
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*
+ * This function is the completion callback of the asynchronous network bring-up
+ * done by cy_lwip_network_up(). It wakes up the waiting caller.
+ */
+static void nw_up_sync_callback(cy_lwip_nw_interface_t *iface, cy_rslt_t result, void *arg)
+{
+    nw_up_sync_t *sync = (nw_up_sync_t *)arg;
+
+    (void)iface;
+    sync->result = result;
+    cy_rtos_set_semaphore(&sync->sem, false);
+}
+
+cy_rslt_t cy_lwip_network_up(cy_lwip_nw_interface_t *iface)
+{
+    cy_rslt_t result;
+    nw_up_sync_t sync;
+    cy_lwip_network_up_params_t params;
+
+    result = cy_rtos_init_semaphore(&sync.sem, 1, 0);
+    if(result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.callback = nw_up_sync_callback;
+    params.arg      = &sync;
+
+    /* The calling thread sleeps until the bring-up completes instead of polling for it */
+    result = cy_lwip_network_up_async(iface, &params);
+    if(result == CY_RSLT_SUCCESS)
+    {
+        cy_rtos_get_semaphore(&sync.sem, CY_RTOS_NEVER_TIMEOUT, false);
+        result = sync.result;
+    }
+
+    cy_rtos_deinit_semaphore(&sync.sem);
+    return result;
+}
+
+cy_rslt_t cy_lwip_network_down(cy_lwip_nw_interface_t *iface)
+{
+    nw_interface_entry_t *nw_interface;
+#if CY_LWIP_PHASE_TIMING
+    cy_lwip_phase_record_t timing;
+#endif
+
+    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    nw_interface = get_nw_interface(iface);
+    if((nw_interface == NULL) || (!nw_interface->is_up && (nw_interface->up_wait == 0)))
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "Network is not UP \r\n");
+        return CY_RSLT_LWIP_INTERFACE_NETWORK_NOT_UP;
+    }
+
+#if CY_LWIP_PHASE_TIMING
+    phase_timing_start(&timing, CY_LWIP_PHASE_OP_NETWORK_DOWN, iface->role);
+#endif
+
+    /*
+     * If LPA is enabled, invoke activity callback to resume the network stack,
+     * before invoking the lwip APIs that requires TCP Core lock.
+     */
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+    /* Abort the bring-up in progress, if any */
+    LOCK_TCPIP_CORE();
+    if(nw_interface->up_wait != 0)
+    {
+#if LWIP_IPV4 && LWIP_AUTOIP
+        if(nw_interface->up_state == NW_UP_STATE_WAIT_AUTOIP)
+        {
+            autoip_stop(&nw_interface->netif);
+        }
+#endif
+        nw_up_complete(nw_interface, CY_RSLT_LWIP_NETWORK_UP_ABORTED);
+    }
+#if OPTIMISTIC_DAD
+    sys_untimeout(optimistic_dad_timer, nw_interface);
+    memset(nw_interface->dad_probes, 0, sizeof(nw_interface->dad_probes));
+#endif
+#if DHCP_LEASE_CACHE
+    sys_untimeout(dhcp_lease_reboot_check, nw_interface);
+#endif
+#if LWIP_IPV4
+    if(nw_interface->renew_in_progress)
+    {
+        dhcp_renew_complete(nw_interface, CY_RSLT_LWIP_DHCP_RENEW_ABORTED);
+    }
+#endif
+#if GATEWAY_ARP_PRESEED
+    gateway_arp_remove(nw_interface);
+    nw_interface->dhcp_server_ip = 0;
+#endif
+    UNLOCK_TCPIP_CORE();
+
+#if LWIP_IPV4
+    if(nw_interface->is_dhcp_client_required)
+    {
+        PHASE_BEGIN(&timing, CY_LWIP_PHASE_DHCP_STOP);
+#if LWIP_AUTOIP
+        if(netif_autoip_data(&nw_interface->netif)->state == AUTOIP_STATE_BOUND)
+        {
+            /*
+             * If LPA is enabled, invoke activity callback to resume the network stack,
+             * before invoking the lwip APIs that requires TCP Core lock.
+             */
+            internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+            autoip_stop(&nw_interface->netif);
+        }
+        else
+#endif
+        {
+            /*
+             * If LPA is enabled, invoke activity callback to resume the network stack,
+             * before invoking the lwip APIs that requires TCP Core lock.
+             */
+            internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+            netifapi_dhcp_release_and_stop(&nw_interface->netif);
+            cy_rtos_delay_milliseconds(DHCP_STOP_DELAY_IN_MS);
+
+            /*
+             * If LPA is enabled, invoke activity callback to resume the network stack,
+             * before invoking the lwip APIs that requires TCP Core lock.
+             */
+            internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+            dhcp_cleanup(&nw_interface->netif);
+        }
+        PHASE_END(&timing, CY_LWIP_PHASE_DHCP_STOP);
+    }
+
+    if(iface->role == CY_LWIP_AP_NW_INTERFACE)
+    {
+        /* Stop internal dhcp server for SoftAP interface */
+        PHASE_BEGIN(&timing, CY_LWIP_PHASE_DHCP_SERVER_STOP);
+        cy_lwip_dhcp_server_stop(&nw_interface->dhcp_server);
+        PHASE_END(&timing, CY_LWIP_PHASE_DHCP_SERVER_STOP);
+    }
+#endif
+
+    /*
+     * If LPA is enabled, invoke activity callback to resume the network stack,
+     * before invoking the lwip APIs that requires TCP Core lock.
+     */
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+    /*
+    * Bring down the network link layer
+    */
+    PHASE_BEGIN(&timing, CY_LWIP_PHASE_LINK_DOWN);
+    netifapi_netif_set_link_down(&nw_interface->netif);
+    PHASE_END(&timing, CY_LWIP_PHASE_LINK_DOWN);
+
+    /*
+    * Bring down the network interface
+    */
+    PHASE_BEGIN(&timing, CY_LWIP_PHASE_NETIF_DOWN);
+    netifapi_netif_set_down(&nw_interface->netif);
+    PHASE_END(&timing, CY_LWIP_PHASE_NETIF_DOWN);
+
+    /* TO DO : clear all ARP cache */
+
+    /** TO DO:
+     *  Kick the radio chip if it's in power save mode in case the link down event is due to missing beacons.
+     *  Setting the chip to the same power save mode is sufficient.
+     */
+    nw_interface->is_up = false;
+#if CY_LWIP_PHASE_TIMING
+    LOCK_TCPIP_CORE();
+    phase_timing_finish(&timing, CY_RSLT_SUCCESS);
+    UNLOCK_TCPIP_CORE();
+#endif
+    return CY_RSLT_SUCCESS;
+}
+
+void cy_lwip_register_ip_change_cb(cy_lwip_ip_change_callback_t cb)
+{
+    ip_change_callback = cb;
+}
+
+cy_rslt_t cy_lwip_ip_change_subscribe(cy_lwip_ip_change_event_callback_t cb, void *arg)
+{
+    ip_change_subscriber_t *free_slot = NULL;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    int i;
+
+    if (cb == NULL)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    LOCK_TCPIP_CORE();
+    for (i = 0; i < CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS; i++)
+    {
+        if ((ip_change_subscribers[i].callback == cb) && (ip_change_subscribers[i].arg == arg))
+        {
+            /* Already subscribed */
+            break;
+        }
+        if ((ip_change_subscribers[i].callback == NULL) && (free_slot == NULL))
+        {
+            free_slot = &ip_change_subscribers[i];
+        }
+    }
+
+    if (i == CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS)
+    {
+        if (free_slot != NULL)
+        {
+            free_slot->callback = cb;
+            free_slot->arg      = arg;
+        }
+        else
+        {
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "IP change subscriber table is full \n");
+            result = CY_RSLT_LWIP_IP_CHANGE_SUBSCRIBER_TABLE_FULL;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return result;
+}
+
+cy_rslt_t cy_lwip_ip_change_unsubscribe(cy_lwip_ip_change_event_callback_t cb, void *arg)
+{
+    cy_rslt_t result = CY_RSLT_LWIP_BAD_ARG;
+    int i;
+
+    LOCK_TCPIP_CORE();
+    for (i = 0; i < CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS; i++)
+    {
+        if ((cb != NULL) && (ip_change_subscribers[i].callback == cb) && (ip_change_subscribers[i].arg == arg))
+        {
+            ip_change_subscribers[i].callback = NULL;
+            ip_change_subscribers[i].arg      = NULL;
+            result = CY_RSLT_SUCCESS;
+            break;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return result;
+}
+
+/*
+ * This function reports a change of a network interface to the IP change subscribers. The
+ * callback registered with cy_lwip_register_ip_change_cb() is invoked for the changes the
+ * LwIP status and remove callbacks it used to be registered as reported: interface up, down
+ * or removed, IPv4 address changed, IPv6 address set on a valid slot, and any change of the
+ * state of an IPv6 address slot, including PREFERRED to DEPRECATED and back.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void ip_change_notify(nw_interface_entry_t *nw_interface, netif_nsc_reason_t reason, const netif_ext_callback_args_t *args)
+{
+    struct netif *netif = &nw_interface->netif;
+    cy_lwip_ip_change_event_t event;
+    bool notify_legacy = false;
+    int i;
+
+    memset(&event, 0, sizeof(event));
+    event.role = nw_interface->role;
+
+    if (reason & LWIP_NSC_NETIF_REMOVED)
+    {
+        event.type    = CY_LWIP_IP_CHANGE_REMOVED;
+        notify_legacy = true;
+    }
+    else if (reason & LWIP_NSC_STATUS_CHANGED)
+    {
+        event.type    = CY_LWIP_IP_CHANGE_STATUS;
+        event.data.up = (args->status_changed.state != 0);
+        notify_legacy = true;
+    }
+    else if (reason & LWIP_NSC_LINK_CHANGED)
+    {
+        event.type    = CY_LWIP_IP_CHANGE_LINK;
+        event.data.up = (args->link_changed.state != 0);
+    }
+#if LWIP_IPV4
+    else if (reason & (LWIP_NSC_IPV4_ADDRESS_CHANGED | LWIP_NSC_IPV4_NETMASK_CHANGED | LWIP_NSC_IPV4_GATEWAY_CHANGED))
+    {
+        event.type = CY_LWIP_IP_CHANGE_IPV4_ADDRESS;
+        ip_addr_copy(event.data.ipv4.new_addr, *netif_ip_addr4(netif));
+        ip_addr_copy(event.data.ipv4.new_netmask, *netif_ip_netmask4(netif));
+        ip_addr_copy(event.data.ipv4.new_gateway, *netif_ip_gw4(netif));
+        event.data.ipv4.old_addr    = event.data.ipv4.new_addr;
+        event.data.ipv4.old_netmask = event.data.ipv4.new_netmask;
+        event.data.ipv4.old_gateway = event.data.ipv4.new_gateway;
+
+        /* LwIP passes the previous value of the settings that changed only */
+        if ((reason & LWIP_NSC_IPV4_ADDRESS_CHANGED) && (args->ipv4_changed.old_address != NULL))
+        {
+            ip_addr_copy(event.data.ipv4.old_addr, *args->ipv4_changed.old_address);
+        }
+        if ((reason & LWIP_NSC_IPV4_NETMASK_CHANGED) && (args->ipv4_changed.old_netmask != NULL))
+        {
+            ip_addr_copy(event.data.ipv4.old_netmask, *args->ipv4_changed.old_netmask);
+        }
+        if ((reason & LWIP_NSC_IPV4_GATEWAY_CHANGED) && (args->ipv4_changed.old_gw != NULL))
+        {
+            ip_addr_copy(event.data.ipv4.old_gateway, *args->ipv4_changed.old_gw);
+        }
+        notify_legacy = ((reason & LWIP_NSC_IPV4_ADDRESS_CHANGED) != 0);
+    }
+#endif
+#if LWIP_IPV6
+    else if (reason & (LWIP_NSC_IPV6_SET | LWIP_NSC_IPV6_ADDR_STATE_CHANGED))
+    {
+        s8_t index = (reason & LWIP_NSC_IPV6_SET) ? args->ipv6_set.addr_index : args->ipv6_addr_state_changed.addr_index;
+
+        event.type                = CY_LWIP_IP_CHANGE_IPV6_ADDRESS;
+        event.data.ipv6.index     = index;
+        event.data.ipv6.new_state = netif_ip6_addr_state(netif, index);
+        event.data.ipv6.old_state = event.data.ipv6.new_state;
+        ip_addr_copy(event.data.ipv6.new_addr, *netif_ip_addr6(netif, index));
+        event.data.ipv6.old_addr  = event.data.ipv6.new_addr;
+
+        if (reason & LWIP_NSC_IPV6_SET)
+        {
+            if (args->ipv6_set.old_address != NULL)
+            {
+                ip_addr_copy(event.data.ipv6.old_addr, *args->ipv6_set.old_address);
+            }
         }
-        wlan_rand = (uint32_t *)whd_buffer_get_current_piece_data_pointer(whd_iface->whd_driver, response);
-        if ( wlan_rand == NULL )
+        else
         {
-            whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
-            return ERR_IF;
+            event.data.ipv6.old_state = args->ipv6_addr_state_changed.old_state;
         }
+        notify_legacy = (reason & LWIP_NSC_IPV6_SET) ? (ip6_addr_isvalid(event.data.ipv6.new_state) != 0) :
+                                                       (event.data.ipv6.old_state != event.data.ipv6.new_state);
     }
+#endif
     else
     {
-        return ERR_IF;
+        return;
     }
 
-    /* Initialize the mutex to protect PRNG well512 state */
-    if (cy_prng_mutex_ptr == NULL)
+    for (i = 0; i < CY_LWIP_IP_CHANGE_MAX_SUBSCRIBERS; i++)
     {
-        cy_prng_mutex_ptr = &cy_prng_mutex;
-        cy_rtos_init_mutex(cy_prng_mutex_ptr);
+        if (ip_change_subscribers[i].callback != NULL)
+        {
+            ip_change_subscribers[i].callback(&event, ip_change_subscribers[i].arg);
+        }
     }
-    /* Feed the random number obtained from WLAN to WELL512
-     * algorithm as initial seed value.
-     */
-    cy_prng_add_entropy((const void *)wlan_rand, 4);
 
-    /*
-     * Free the whd buffer used to get the random number from WLAN.
-     */
-    whd_buffer_release(whd_iface->whd_driver, response, WHD_NETWORK_RX);
-#endif
-    /*
-     * Setup the information associated with sending packets
-     */
-#if LWIP_IPV4
-    iface->output = etharp_output;
-#endif
-    iface->linkoutput = wifioutput;
-    iface->mtu = WHD_LINK_MTU;
-    iface->flags |= (NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP) ;
-#ifdef LWIP_IPV6_MLD
-    iface->flags |= NETIF_FLAG_MLD6;
+    /* notify wcm about ip change */
+    if (notify_legacy && (ip_change_callback != NULL))
+    {
+        ip_change_callback(&event);
+    }
+}
+
+/*
+ * This functions helps to register/unregister callback for network activity
+ */
+void cy_network_activity_register_cb(cy_network_activity_event_callback_t cb)
+{
+#if CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS > 0
+    /* Make sure the first activity after registration always reaches the new callback */
+    activity_notified[CY_NETWORK_ACTIVITY_TX] = false;
+    activity_notified[CY_NETWORK_ACTIVITY_RX] = false;
 #endif
-    /*
-     * Set the interface name for the interface
-     */
-    iface->name[0] = 'w' ;
-    iface->name[1] = 'l' ;
+    /* update the activity callback with the argument passed */
+    activity_callback = cb;
+}
 
-#if LWIP_IPV4 && LWIP_IGMP
-    netif_set_igmp_mac_filter(iface, igmp_filter) ;
+/*
+ * This function invokes the network activity callback. Notifications of the same activity
+ * type are coalesced: the callback is invoked again only once CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS
+ * has elapsed since the previous invocation. As long as the window is shorter than the LPA
+ * network inactivity window, LPA cannot have suspended the network stack in between, so the
+ * stack is still guaranteed to be resumed before the TCP/IP core lock is taken.
+ */
+static void internal_network_activity_notify(cy_network_activity_type_t activity_type)
+{
+    cy_network_activity_event_callback_t callback = activity_callback;
+
+    if (callback == NULL)
+    {
+        return;
+    }
+
+#if CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS > 0
+    {
+        uint32_t now = sys_now();
+
+        if (activity_notified[activity_type] &&
+            ((uint32_t)(now - activity_notify_time[activity_type]) < CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS))
+        {
+            return;
+        }
+        activity_notify_time[activity_type] = now;
+        activity_notified[activity_type]    = true;
+    }
 #endif
 
+    callback(activity_type == CY_NETWORK_ACTIVITY_TX);
+}
 
-#if LWIP_IPV6 == 1
-    /*
-     * Filter output packets for IPV6 through the ethernet output
-     * function for IPV6.
-     */
-    iface->output_ip6 = ethip6_output ;
+/*
+ * This function notifies network activity to LPA module.
+ */
+cy_rslt_t cy_network_activity_notify(cy_network_activity_type_t activity_type)
+{
+    if((activity_type != CY_NETWORK_ACTIVITY_TX) && (activity_type != CY_NETWORK_ACTIVITY_RX))
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Invalid network activity type\n");
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
 
-    /*
-     * Automatically generate a unicast IP address based on
-     * neighbor discovery.
-     */
-    iface->ip6_autoconfig_enabled = 1 ;
+    internal_network_activity_notify(activity_type);
+    return CY_RSLT_SUCCESS;
+}
+#if LWIP_IPV4
+cy_rslt_t cy_lwip_dhcp_renew(cy_lwip_nw_interface_t *iface)
+{
+    nw_interface_entry_t *nw_interface;
 
-    /*
-     * Create a link local IPV6 address
-     */
-    netif_create_ip6_linklocal_address(iface, 1);
+    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
 
-    /*
-     * Tell the radio that we want to listen to solicited-node multicast
-     * packets.  These packets are part of the IPV6 neighbor discovery
-     * process.
-     */
-    macaddr.octet[0] = 0x33 ;
-    macaddr.octet[1] = 0x33 ;
-    macaddr.octet[2] = 0xff ;
-    whd_wifi_register_multicast_address(iface->state, &macaddr) ;
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
+    {
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
+    }
+    /* Invalidate ARP entries */
+    netifapi_netif_common(&nw_interface->netif, (netifapi_void_fn) invalidate_all_arp_entries, NULL );
 
-    /*
-     * Tell the radio that we want to listen to the multicast address
-     * that targets all IPV6 devices.  These packets are part of the IPV6
-     * neighbor discovery process.
-     */
-    memset(&macaddr, 0, sizeof(macaddr)) ;
-    macaddr.octet[0] = 0x33 ;
-    macaddr.octet[1] = 0x33 ;
-    macaddr.octet[5] = 0x01 ;
-    whd_wifi_register_multicast_address(iface->state, &macaddr) ;
 
-#if LWIP_IPV6_MLD
     /*
-     * Register mld mac filter callback function that will be called by lwIP to add or delete an
-     * entry in the IPv6 multicast filter table of the ethernet MAC.
+     * If LPA is enabled, invoke activity callback to resume the network stack,
+     * before invoking the lwip APIs that requires TCP Core lock.
      */
-    netif_set_mld_mac_filter(iface, mld_mac_filter);
-#endif
-#endif
-    return 0 ;
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+    /* DHCP renewal*/
+    netifapi_netif_common(&nw_interface->netif, (netifapi_void_fn)dhcp_renew, NULL);
+
+    cy_rtos_delay_milliseconds(DCHP_RENEWAL_DELAY_IN_MS);
+    return CY_RSLT_SUCCESS;
 }
 
-/*
- * This is the main entry point in this file.  This function takes a WHD radio driver
- * handle, interface type and static IP address, and adds interface to LwIP.
- * note : static IP address is optional for STA interface.
+/**
+ * Remove all ARP table entries of the specified netif.
+ * @param netif points to a network interface
  */
-cy_rslt_t cy_lwip_add_interface(cy_lwip_nw_interface_t *iface, ip_static_addr_t *static_ipaddr)
+static void invalidate_all_arp_entries(struct netif *netif)
 {
-#if LWIP_IPV4
-    ip4_addr_t ipaddr, netmask, gateway ;
-#endif
+     /*free all the entries in arp list */
+    etharp_cleanup_netif(netif);
+}
 
-    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+cy_rslt_t cy_lwip_dhcp_server_configure(cy_lwip_nw_interface_t *iface, const cy_lwip_dhcp_server_config_t *config)
+{
+    nw_interface_entry_t *nw_interface;
+
+    if((is_interface_valid(iface) != CY_RSLT_SUCCESS) || (iface->role != CY_LWIP_AP_NW_INTERFACE) || (config == NULL))
     {
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
-    /* static IP addr is mandatory for AP */
-    if((iface->role == CY_LWIP_AP_NW_INTERFACE) && (static_ipaddr == NULL))
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
+    {
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
+    }
+
+    nw_interface->dhcp_server_config = *config;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cy_lwip_dhcp_server_get_stats(cy_lwip_nw_interface_t *iface, cy_lwip_dhcp_server_stats_t *stats)
+{
+    nw_interface_entry_t *nw_interface;
+
+    if((is_interface_valid(iface) != CY_RSLT_SUCCESS) || (iface->role != CY_LWIP_AP_NW_INTERFACE) || (stats == NULL))
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error static IP addr cannot be NULL for AP interface \n");
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
-    if (is_interface_added(iface->role))
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
     {
-        return CY_RSLT_SUCCESS;
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
     }
 
-#if LWIP_IPV4
-    /* Assign the IP address if static, otherwise, zero the IP address */
-    if (static_ipaddr != NULL)
+    LOCK_TCPIP_CORE();
+    *stats = nw_interface->dhcp_server.stats;
+    UNLOCK_TCPIP_CORE();
+    return CY_RSLT_SUCCESS;
+}
+
+/*
+ * This function sends an ARP request straight to the MAC address a peer is known by, to check
+ * that the peer is still reachable there without broadcasting. LwIP refreshes the ARP entry
+ * when the reply comes in.
+ */
+static void arp_send_unicast_probe(struct netif *netif, const ip4_addr_t *ipaddr, const struct eth_addr *ethaddr)
+{
+    struct pbuf *p;
+    struct etharp_hdr *hdr;
+
+    p = pbuf_alloc(PBUF_LINK, SIZEOF_ETHARP_HDR, PBUF_RAM);
+    if (p == NULL)
     {
-        memcpy(&gateway, &static_ipaddr->gateway, sizeof(gateway));
-        memcpy(&ipaddr, &static_ipaddr->addr, sizeof(ipaddr));
-        memcpy(&netmask, &static_ipaddr->netmask, sizeof(netmask));
+        return;
     }
-    else
+
+    hdr = (struct etharp_hdr *)p->payload;
+    hdr->hwtype   = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+    hdr->proto    = PP_HTONS(ETHTYPE_IP);
+    hdr->hwlen    = ETH_HWADDR_LEN;
+    hdr->protolen = sizeof(ip4_addr_t);
+    hdr->opcode   = PP_HTONS(ARP_REQUEST);
+    SMEMCPY(&hdr->shwaddr, netif->hwaddr, ETH_HWADDR_LEN);
+    memset(&hdr->dhwaddr, 0, ETH_HWADDR_LEN);
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->sipaddr, netif_ip4_addr(netif));
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->dipaddr, ipaddr);
+
+    ethernet_output(netif, p, (const struct eth_addr *)netif->hwaddr, ethaddr, ETHTYPE_ARP);
+    pbuf_free(p);
+}
+
+/*
+ * This function probes the gateway and the peers in the ARP cache of the interface by unicast.
+ * The gateway is resolved by broadcast if it is not in the cache. Static entries are skipped,
+ * as LwIP never updates them from an ARP reply: the static entry of the gateway is removed so
+ * that a gateway which moved is learned again, those of the DHCP server leases are left alone.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void arp_revalidate_start(nw_interface_entry_t *nw_interface)
+{
+    struct netif *netif = &nw_interface->netif;
+    const ip4_addr_t *gw = netif_ip4_gw(netif);
+    bool gw_probed = false;
+    ip4_addr_t *ipaddr;
+    struct netif *entry_netif;
+    struct eth_addr *ethaddr[ARP_TABLE_SIZE];
+    ip4_addr_t probe_addr;
+    uint8_t count = 0;
+    size_t i;
+
+    nw_interface->arp_probing = false;
+#if GATEWAY_ARP_PRESEED
+    gateway_arp_remove(nw_interface);
+#endif
+
+    /* The probes are recorded before arp_probing publishes them to the receive thread */
+    for (i = 0; i < ARP_TABLE_SIZE; i++)
     {
-        memset(&gateway, 0, sizeof(gateway));
-        memset(&ipaddr, 0, sizeof(ipaddr));
-        memset(&netmask, 0, sizeof(netmask));
+        /* Only the stable entries are returned, that is the peers recently talked to */
+        if (!etharp_get_entry(i, &ipaddr, &entry_netif, &ethaddr[count]) || (entry_netif != netif) ||
+            cy_lwip_dhcp_server_is_lease_arp_entry(ipaddr))
+        {
+            continue;
+        }
+
+        ip4_addr_copy(nw_interface->arp_probe_addr[count], *ipaddr);
+        nw_interface->arp_probe_answered[count] = false;
+        count++;
+
+        if (ip4_addr_cmp(ipaddr, gw))
+        {
+            gw_probed = true;
+        }
     }
+    nw_interface->arp_probe_count = count;
+    nw_interface->arp_probing     = (count != 0);
 
-    /* Add the interface to LwIP and make it the default */
-    if(netifapi_netif_add((IP_HANDLE(iface->role)), &ipaddr, &netmask, &gateway, iface->whd_iface, wifiinit, tcpip_input) != CY_RSLT_SUCCESS)
+    /* Sent once published, for the replies to be matched */
+    for (i = 0; i < count; i++)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error adding interface \n");
-        return CY_RSLT_LWIP_ERROR_ADDING_INTERFACE;
+        ip4_addr_copy(probe_addr, nw_interface->arp_probe_addr[i]);
+        arp_send_unicast_probe(netif, &probe_addr, ethaddr[i]);
     }
-#else
-    if(netifapi_netif_add((IP_HANDLE(iface->role)), iface->whd_iface, wifiinit, tcpip_input) != CY_RSLT_SUCCESS)
+
+    if (!gw_probed && !ip4_addr_isany(gw))
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error adding interface \n");
-        return CY_RSLT_LWIP_ERROR_ADDING_INTERFACE;
+        etharp_request(netif, gw);
     }
-#endif
+}
 
-    if(iface->role == CY_LWIP_STA_NW_INTERFACE)
+/*
+ * This function marks the peer which sent an ARP reply as answered, if it was probed.
+ * Runs in the WHD receive thread, on the raw ethernet frame.
+ */
+static void arp_revalidate_capture(nw_interface_entry_t *nw_interface, const uint8_t *data, uint16_t length)
+{
+    const uint8_t *arp = data + ETHERNET_HEADER_LENGTH;
+    uint32_t sender_ip;
+    uint8_t i;
+
+    if ((length < (ETHERNET_HEADER_LENGTH + SIZEOF_ETHARP_HDR)) || (((arp[6] << 8) | arp[7]) != ARP_REPLY))
     {
-        if(static_ipaddr == NULL)
+        return;
+    }
+
+    /* Sender protocol address, in network byte order as ip4_addr_t */
+    memcpy(&sender_ip, arp + 14, sizeof(sender_ip));
+    for (i = 0; i < nw_interface->arp_probe_count; i++)
+    {
+        if (ip4_addr_get_u32(&nw_interface->arp_probe_addr[i]) == sender_ip)
         {
-            is_dhcp_client_required = true;
+            nw_interface->arp_probe_answered[i] = true;
         }
-        netifapi_netif_set_default(IP_HANDLE(iface->role)) ;
     }
+}
 
-    /*
-     * Register a handler for any address changes
-     * Note : The "status" callback will also be called when the interface
-     * goes up or down
-     */
-    netif_set_status_callback((IP_HANDLE(iface->role)), internal_ip_change_callback);
-    SET_IP_NETWORK_INITED(iface->role, true);
+/*
+ * This function ends the ARP probes of a DHCP renewal. The peers which did not answer at their
+ * known MAC address are asked again by broadcast, in case they moved.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void arp_revalidate_finish(nw_interface_entry_t *nw_interface)
+{
+    uint8_t i;
 
-    return CY_RSLT_SUCCESS ;
+    ip4_addr_t probe_addr;
+
+    nw_interface->arp_probing = false;
+    for (i = 0; i < nw_interface->arp_probe_count; i++)
+    {
+        if (!nw_interface->arp_probe_answered[i])
+        {
+            ip4_addr_copy(probe_addr, nw_interface->arp_probe_addr[i]);
+            etharp_request(&nw_interface->netif, &probe_addr);
+        }
+    }
 }
 
-struct netif* cy_lwip_get_interface(cy_lwip_nw_interface_role_t role)
+/*
+ * This function completes an asynchronous DHCP renewal and reports the result to the caller.
+ * Must be called with the TCP/IP core lock held.
+ */
+static void dhcp_renew_complete(nw_interface_entry_t *nw_interface, cy_rslt_t result)
 {
-    if((role != CY_LWIP_AP_NW_INTERFACE) && (role != CY_LWIP_STA_NW_INTERFACE))
+    cy_lwip_dhcp_renew_params_t params = nw_interface->renew_params;
+
+    sys_untimeout(dhcp_renew_timer, nw_interface);
+    nw_interface->renew_in_progress = false;
+    nw_interface->arp_probing       = false;
+
+    if (params.callback != NULL)
     {
-        return NULL;
+        params.callback(&nw_interface->renew_iface, result, params.arg);
     }
-    return (IP_HANDLE(role));
 }
 
-cy_rslt_t cy_lwip_remove_interface(cy_lwip_nw_interface_t *iface)
+/*
+ * This function tracks an asynchronous DHCP renewal until the lease is acknowledged and the
+ * ARP probes are over. It runs in the TCP/IP thread.
+ */
+static void dhcp_renew_timer(void *arg)
 {
-    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    nw_interface_entry_t *nw_interface = (nw_interface_entry_t *)arg;
+    struct dhcp *dhcp = netif_dhcp_data(&nw_interface->netif);
+    uint32_t elapsed = sys_now() - nw_interface->renew_start;
+
+    if (nw_interface->arp_probing && (elapsed >= CY_LWIP_ARP_REVALIDATE_TIMEOUT_MS))
     {
-        return CY_RSLT_LWIP_BAD_ARG;
+        arp_revalidate_finish(nw_interface);
     }
 
-    /* Interface can be removed only if the interface was previously added and network is down */
-    if(!is_interface_added(iface->role))
+    if (nw_interface->renew_wait_dhcp && (dhcp != NULL) && (dhcp->state == DHCP_STATE_BOUND))
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error Interface doesn't exist \n");
-        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
+        nw_interface->renew_wait_dhcp = false;
     }
 
-    if(is_network_up(iface->role))
+    if (!nw_interface->renew_wait_dhcp && !nw_interface->arp_probing)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error removing interface, bring down the network before removing the interface \n");
-        return CY_RSLT_LWIP_ERROR_REMOVING_INTERFACE;
-    }
-    /* remove status callback */
-    netif_set_remove_callback(IP_HANDLE(iface->role), internal_ip_change_callback);
-    /* remove the interface */
-    netifapi_netif_remove(IP_HANDLE(iface->role));
-    if(iface->role == CY_LWIP_STA_NW_INTERFACE)
+        dhcp_renew_complete(nw_interface, CY_RSLT_SUCCESS);
+    }
+    else if (elapsed >= CY_LWIP_DHCP_RENEW_TIMEOUT_MS)
     {
-        is_dhcp_client_required = false;
+        /* LwIP keeps trying to renew the lease */
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "DHCP renewal not acknowledged\n");
+        dhcp_renew_complete(nw_interface, CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT);
     }
-
-    SET_IP_NETWORK_INITED(iface->role, false);
-#ifdef COMPONENT_43907
-    /* cy_prng_mutex_ptr is initialized when the first network intefrace is initialized.
-     * Deinitialize the mutex only after all the interfaces are deinitiazed.
-     */
-    if (!ip_networking_inited[CY_LWIP_STA_NW_INTERFACE] &&
-        !ip_networking_inited[CY_LWIP_AP_NW_INTERFACE])
+    else
     {
-        if (cy_prng_mutex_ptr != NULL)
-        {
-            cy_rtos_deinit_mutex(cy_prng_mutex_ptr);
-            cy_prng_mutex_ptr = NULL;
-        }
+        sys_timeout(DHCP_RENEW_POLL_INTERVAL_MS, dhcp_renew_timer, nw_interface);
     }
-#endif
-    return CY_RSLT_SUCCESS;
 }
 
-cy_rslt_t cy_lwip_network_up(cy_lwip_nw_interface_t *iface)
+/*
+ * This function starts a DHCP renewal and the refresh of the ARP cache, then returns.
+ * The renewal is tracked by dhcp_renew_timer() from then on.
+ */
+cy_rslt_t cy_lwip_dhcp_renew_async(cy_lwip_nw_interface_t *iface, const cy_lwip_dhcp_renew_params_t *params)
 {
-    cy_rslt_t result                     = CY_RSLT_SUCCESS;
-    uint32_t  address_resolution_timeout = 0;
-    bool      timeout_occurred           = false;
+    nw_interface_entry_t *nw_interface;
+    struct netif *netif;
 
-#if LWIP_IPV4
-    ip4_addr_t ip_addr;
-#endif
-    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    if((is_interface_valid(iface) != CY_RSLT_SUCCESS) || (params == NULL) ||
+       ((params->mode != CY_LWIP_DHCP_RENEW_ARP_FLUSH) && (params->mode != CY_LWIP_DHCP_RENEW_ARP_REVALIDATE)))
     {
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
-    if(is_network_up(iface->role))
+    nw_interface = get_nw_interface(iface);
+    if(nw_interface == NULL)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "Network is already up \n");
-        return CY_RSLT_SUCCESS;
+        return CY_RSLT_LWIP_INTERFACE_DOES_NOT_EXIST;
     }
+    netif = &nw_interface->netif;
 
     /*
      * If LPA is enabled, invoke activity callback to resume the network stack,
      * before invoking the lwip APIs that requires TCP Core lock.
      */
-    if (activity_callback)
+    internal_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+
+    LOCK_TCPIP_CORE();
+    if(!nw_interface->is_up)
     {
-        activity_callback(true);
+        UNLOCK_TCPIP_CORE();
+        return CY_RSLT_LWIP_INTERFACE_NETWORK_NOT_UP;
     }
-
-    /*
-    * Bring up the network interface.
-    */
-    netifapi_netif_set_up((IP_HANDLE(iface->role)));
-
-    /*
-    * Bring up the network link layer
-    */
-    netifapi_netif_set_link_up((IP_HANDLE(iface->role)));
-
-#if LWIP_IPV6
-    /* Wait for IPV6 address to change from tentative to valid or invalid */
-    while(ip6_addr_istentative(netif_ip6_addr_state(IP_HANDLE(iface->role), 0)))
+    if(nw_interface->renew_in_progress)
     {
-        /* Give LwIP time to change the state */
-        cy_rtos_delay_milliseconds(ND6_TMR_INTERVAL);
+        UNLOCK_TCPIP_CORE();
+        return CY_RSLT_LWIP_DHCP_RENEW_IN_PROGRESS;
     }
 
-    /* LWIP changes state to either INVALID or VALID. Check if the state is VALID */
-    if(ip6_addr_isvalid(netif_ip6_addr_state(IP_HANDLE(iface->role), 0)))
+    nw_interface->renew_in_progress = true;
+    nw_interface->renew_iface       = *iface;
+    nw_interface->renew_params      = *params;
+    nw_interface->renew_start       = sys_now();
+
+    if(params->mode == CY_LWIP_DHCP_RENEW_ARP_FLUSH)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "IPv6 Network ready IP: %s \r\n", ip6addr_ntoa(netif_ip6_addr(IP_HANDLE(iface->role), 0)));
+        invalidate_all_arp_entries(netif);
     }
     else
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "IPv6 network not ready \r\n");
+        arp_revalidate_start(nw_interface);
     }
-#endif
 
-#if LWIP_IPV4
-    if(iface->role == CY_LWIP_STA_NW_INTERFACE)
+    /* Static and AutoIP addresses have no lease to renew */
+    nw_interface->renew_wait_dhcp = false;
+    if(dhcp_supplied_address(netif))
     {
-        if(is_dhcp_client_required)
+        if(dhcp_renew(netif) != ERR_OK)
         {
-            /* TO DO :  Save the current power save state */
-            /* TO DO :  Disable power save for the DHCP exchange */
-
-            /*
-             * For DHCP only, we should reset netif IP address
-             * We don't want to re-use previous netif IP address
-             * given from previous DHCP session
-             */
-            ip4_addr_set_zero(&ip_addr);
-
-            /*
-             * If LPA is enabled, invoke activity callback to resume the network stack,
-             * before invoking the lwip APIs that requires TCP Core lock.
-             */
-            if (activity_callback)
-            {
-                activity_callback(true);
-            }
+            /* Reported right away instead of as a timeout; the ARP cache refresh already sent goes on */
+            nw_interface->renew_in_progress = false;
+            nw_interface->arp_probing       = false;
+            UNLOCK_TCPIP_CORE();
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to send the DHCP renewal request\n");
+            return CY_RSLT_LWIP_DHCP_RENEW_FAILED;
+        }
+        nw_interface->renew_wait_dhcp = true;
+    }
 
-            netif_set_ipaddr(IP_HANDLE(iface->role), &ip_addr);
+    sys_timeout(DHCP_RENEW_POLL_INTERVAL_MS, dhcp_renew_timer, nw_interface);
+    UNLOCK_TCPIP_CORE();
 
-            /*
-             * If LPA is enabled, invoke activity callback to resume the network stack,
-             * before invoking the lwip APIs that requires TCP Core lock.
-             */
-            if (activity_callback)
-            {
-                activity_callback(true);
-            }
+    return CY_RSLT_SUCCESS;
+}
+#endif
 
-            /* TO DO : DHCPV6 need to be handled when we support IPV6 addresses other than the link local address */
-            /* Start DHCP */
-            if(netifapi_dhcp_start(IP_HANDLE(iface->role)) != CY_RSLT_SUCCESS)
-            {
-                return CY_RSLT_LWIP_ERROR_STARTING_DHCP;
-            }
-            /* Wait a little to allow DHCP a chance to complete */
+/*
+ * Looks up the handler registered for the ethertype on the given interface role.
+ * The table is open-addressed with linear probing, so a lookup touches at most
+ * CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE slots and usually just one.
+ */
+static ethertype_handler_entry_t *find_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role)
+{
+    uint32_t slot = ETHERTYPE_HANDLER_HASH(ethertype, role);
+    uint32_t probes;
 
-            while((netif_dhcp_data(IP_HANDLE(iface->role))->state != DHCP_STATE_BOUND) && (timeout_occurred == false))
-            {
-                cy_rtos_delay_milliseconds(10);
-                address_resolution_timeout += 10;
-                if(address_resolution_timeout >= DHCP_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS)
-                {
-                    /* timeout has occurred */
-                    timeout_occurred = true;
-                }
-            }
+    for (probes = 0; probes < CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE; probes++)
+    {
+        ethertype_handler_entry_t *entry = &ethertype_handlers[slot];
 
-            if (timeout_occurred)
-            {
-                /*
-                 * If LPA is enabled, invoke activity callback to resume the network stack,
-                 * before invoking the lwip APIs that requires TCP Core lock.
-                 */
-                if (activity_callback)
-                {
-                    activity_callback(true);
-                }
-                netifapi_dhcp_release_and_stop(IP_HANDLE(iface->role));
-#if LWIP_AUTOIP
-                int   tries = 0;
-                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "Unable to obtain IP address via DHCP. Perform Auto IP\n");
-                address_resolution_timeout = 0;
-                timeout_occurred            = false;
-
-                /*
-                 * If LPA is enabled, invoke activity callback to resume the network stack,
-                 * before invoking the lwip APIs that requires TCP Core lock.
-                 */
-                if (activity_callback)
-                {
-                    activity_callback(true);
-                }
+        if (entry->state == ETHERTYPE_HANDLER_SLOT_EMPTY)
+        {
+            break;
+        }
+        if ((entry->state == ETHERTYPE_HANDLER_SLOT_USED) && (entry->ethertype == ethertype) && (entry->role == (uint8_t)role))
+        {
+            return entry;
+        }
+        slot = (slot + 1) & ETHERTYPE_HANDLER_TABLE_MASK;
+    }
 
-                if (autoip_start(IP_HANDLE(iface->role) ) != ERR_OK )
-                {
-                    /* trick: skip the while-loop, do the cleaning up stuff */
-                    timeout_occurred = true;
-                }
+    return NULL;
+}
 
-                while ((timeout_occurred == false) && ((netif_autoip_data(IP_HANDLE(iface->role))->state != AUTOIP_STATE_BOUND)))
-                {
-                    cy_rtos_delay_milliseconds(10);
-                    address_resolution_timeout += 10;
-                    if(address_resolution_timeout >= AUTO_IP_ADDRESS_RESOLUTION_TIMEOUT_IN_MS)
-                    {
-                        if(tries++ < MAX_AUTO_IP_RETRIES)
-                        {
-                            address_resolution_timeout = 0;
-                        }
-                        else
-                        {
-                            timeout_occurred = true;
-                        }
-                     }
-                }
+/*
+ * Frees a slot of the ethertype handler table. The slot is left as a tombstone only when
+ * a probe sequence goes on past it; otherwise it and the tombstones before it become empty
+ * again, so that lookups do not degrade to a full scan after registration churn.
+ * Must be called within SYS_ARCH_PROTECT.
+ */
+static void remove_ethertype_handler(ethertype_handler_entry_t *entry)
+{
+    uint32_t slot = (uint32_t)(entry - ethertype_handlers);
+    uint32_t probes;
 
-                if (timeout_occurred)
-                {
-                    wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to obtain IP address via DCHP and AutoIP\n");
-
-                    /*
-                     * If LPA is enabled, invoke activity callback to resume the network stack,
-                     * before invoking the lwip APIs that requires TCP Core lock.
-                     */
-                    if (activity_callback)
-                    {
-                        activity_callback(true);
-                    }
-
-                    autoip_stop(IP_HANDLE(iface->role));
-                    return CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT;
-                }
-                else
-                {
-                    wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "IP address obtained through AutoIP \n");
-                }
-#else
-                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to obtain IP address via DHCP\n");
-                return CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT;
-#endif
-            }
-        }
+    ethertype_handler_count--;
+    if (ethertype_handlers[(slot + 1) & ETHERTYPE_HANDLER_TABLE_MASK].state != ETHERTYPE_HANDLER_SLOT_EMPTY)
+    {
+        entry->state = ETHERTYPE_HANDLER_SLOT_DELETED;
+        return;
     }
-    else
+
+    entry->state = ETHERTYPE_HANDLER_SLOT_EMPTY;
+    for (probes = 1; probes < CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE; probes++)
     {
-        memset(&internal_dhcp_server, 0, sizeof(internal_dhcp_server));
-        igmp_start(IP_HANDLE(iface->role));
-        /* Start internal DHCP server */
-        if((result = cy_lwip_dhcp_server_start(&internal_dhcp_server, iface->role))!= CY_RSLT_SUCCESS)
+        slot = (slot - 1) & ETHERTYPE_HANDLER_TABLE_MASK;
+        if (ethertype_handlers[slot].state != ETHERTYPE_HANDLER_SLOT_DELETED)
         {
-            return CY_RSLT_LWIP_ERROR_STARTING_DHCP;
+            break;
         }
+        ethertype_handlers[slot].state = ETHERTYPE_HANDLER_SLOT_EMPTY;
     }
-#endif
-
-    SET_IP_UP(iface->role, true);
-    return result;
 }
 
-cy_rslt_t cy_lwip_network_down(cy_lwip_nw_interface_t *iface)
+cy_rslt_t cy_lwip_register_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role, cy_lwip_ethertype_handler_t handler, void *arg)
 {
-    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
+    ethertype_handler_entry_t *entry;
+    ethertype_handler_entry_t *free_entry = NULL;
+    uint32_t slot;
+    uint32_t probes;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if ((handler == NULL) || ((role != CY_LWIP_AP_NW_INTERFACE) && (role != CY_LWIP_STA_NW_INTERFACE)))
     {
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
-    if(!is_network_up(iface->role))
+    SYS_ARCH_PROTECT(lev);
+
+    /* Replace the handler if the ethertype is already registered on this role */
+    entry = find_ethertype_handler(ethertype, role);
+    if (entry != NULL)
     {
-        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_INFO, "Network is not UP \r\n");
-        return CY_RSLT_LWIP_INTERFACE_NETWORK_NOT_UP;
+        remove_ethertype_handler(entry);
     }
 
-#if LWIP_IPV4
-    if(is_dhcp_client_required)
+    /* Take the first empty or deleted slot along the probe sequence */
+    slot = ETHERTYPE_HANDLER_HASH(ethertype, role);
+    for (probes = 0; probes < CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE; probes++)
     {
-#if LWIP_AUTOIP
-        if(netif_autoip_data(IP_HANDLE(iface->role))->state == AUTOIP_STATE_BOUND)
-        {
-            /*
-             * If LPA is enabled, invoke activity callback to resume the network stack,
-             * before invoking the lwip APIs that requires TCP Core lock.
-             */
-            if (activity_callback)
-            {
-                activity_callback(true);
-            }
-
-            autoip_stop(IP_HANDLE(iface->role));
-        }
-        else
-#endif
+        if (ethertype_handlers[slot].state != ETHERTYPE_HANDLER_SLOT_USED)
         {
-            /*
-             * If LPA is enabled, invoke activity callback to resume the network stack,
-             * before invoking the lwip APIs that requires TCP Core lock.
-             */
-            if (activity_callback)
-            {
-                activity_callback(true);
-            }
-
-            netifapi_dhcp_release_and_stop(IP_HANDLE(iface->role));
-            cy_rtos_delay_milliseconds(DHCP_STOP_DELAY_IN_MS);
-
-            /*
-             * If LPA is enabled, invoke activity callback to resume the network stack,
-             * before invoking the lwip APIs that requires TCP Core lock.
-             */
-            if (activity_callback)
-            {
-                activity_callback(true);
-            }
-
-            dhcp_cleanup(IP_HANDLE(iface->role));
+            free_entry = &ethertype_handlers[slot];
+            break;
         }
+        slot = (slot + 1) & ETHERTYPE_HANDLER_TABLE_MASK;
     }
 
-    if(iface->role == CY_LWIP_AP_NW_INTERFACE)
+    if (free_entry == NULL)
     {
-        /* Stop internal dhcp server for SoftAP interface */
-        cy_lwip_dhcp_server_stop(&internal_dhcp_server);
+        SYS_ARCH_UNPROTECT(lev);
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Ethertype handler table is full\n");
+        return CY_RSLT_LWIP_ETHERTYPE_HANDLER_TABLE_FULL;
     }
-#endif
 
-    /*
-     * If LPA is enabled, invoke activity callback to resume the network stack,
-     * before invoking the lwip APIs that requires TCP Core lock.
-     */
-    if (activity_callback)
-    {
-        activity_callback(true);
-    }
+    free_entry->handler   = handler;
+    free_entry->arg       = arg;
+    free_entry->ethertype = ethertype;
+    free_entry->role      = (uint8_t)role;
+    /* Publish the slot last so that the RX path never sees a partially filled entry */
+    free_entry->state     = ETHERTYPE_HANDLER_SLOT_USED;
+    ethertype_handler_count++;
 
-    /*
-    * Bring down the network link layer
-    */
-    netifapi_netif_set_link_down(IP_HANDLE(iface->role));
+    SYS_ARCH_UNPROTECT(lev);
+    return CY_RSLT_SUCCESS;
+}
 
-    /*
-    * Bring down the network interface
-    */
-    netifapi_netif_set_down(IP_HANDLE(iface->role));
+cy_rslt_t cy_lwip_unregister_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role)
+{
+    ethertype_handler_entry_t *entry;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    /* TO DO : clear all ARP cache */
+    SYS_ARCH_PROTECT(lev);
+    entry = find_ethertype_handler(ethertype, role);
+    if (entry == NULL)
+    {
+        SYS_ARCH_UNPROTECT(lev);
+        return CY_RSLT_LWIP_ETHERTYPE_HANDLER_NOT_FOUND;
+    }
+    remove_ethertype_handler(entry);
+    SYS_ARCH_UNPROTECT(lev);
 
-    /** TO DO:
-     *  Kick the radio chip if it's in power save mode in case the link down event is due to missing beacons.
-     *  Setting the chip to the same power save mode is sufficient.
-     */
-    SET_IP_UP(iface->role, false);
     return CY_RSLT_SUCCESS;
 }
 
-void cy_lwip_register_ip_change_cb(cy_lwip_ip_change_callback_t cb)
+/* Adapts the EAPOL handler to the generic ethertype handler prototype */
+static void eapol_ethertype_handler(whd_interface_t iface, whd_buffer_t buf, void *arg)
 {
-    ip_change_callback = cb;
-}
+    cy_wifimwcore_eapol_packet_handler_t handler = internal_eapol_packet_handler;
 
-/*
- * This functions helps to register/unregister callback for network activity
- */
-void cy_network_activity_register_cb(cy_network_activity_event_callback_t cb)
-{
-    /* update the activity callback with the argument passed */
-    activity_callback = cb;
+    (void)arg;
+    if (handler != NULL)
+    {
+        handler(iface, buf);
+    }
+    else
+    {
+        cy_buffer_release(buf, WHD_NETWORK_RX) ;
+    }
 }
 
-/*
- * This function notifies network activity to LPA module.
- */
-cy_rslt_t cy_network_activity_notify(cy_network_activity_type_t activity_type)
+/* Used to register callback for EAPOL packets */
+cy_rslt_t cy_wifimwcore_eapol_register_receive_handler( cy_wifimwcore_eapol_packet_handler_t eapol_packet_handler )
 {
-    if(activity_callback)
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    internal_eapol_packet_handler = eapol_packet_handler;
+    if (eapol_packet_handler != NULL)
     {
-        if(activity_type == CY_NETWORK_ACTIVITY_TX)
-        {
-            activity_callback(true);
-        }
-        else if(activity_type == CY_NETWORK_ACTIVITY_RX)
+        /* EAPOL packets are redirected on both STA and AP interfaces */
+        result = cy_lwip_register_ethertype_handler(EAPOL_PACKET_TYPE, CY_LWIP_STA_NW_INTERFACE, eapol_ethertype_handler, NULL);
+        if (result == CY_RSLT_SUCCESS)
         {
-            activity_callback(false);
+            result = cy_lwip_register_ethertype_handler(EAPOL_PACKET_TYPE, CY_LWIP_AP_NW_INTERFACE, eapol_ethertype_handler, NULL);
+            if (result != CY_RSLT_SUCCESS)
+            {
+                cy_lwip_unregister_ethertype_handler(EAPOL_PACKET_TYPE, CY_LWIP_STA_NW_INTERFACE);
+                internal_eapol_packet_handler = NULL;
+            }
         }
         else
         {
-            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Invalid network activity type\n");
-            return CY_RSLT_LWIP_BAD_ARG;
+            internal_eapol_packet_handler = NULL;
         }
     }
-
-    return CY_RSLT_SUCCESS;
-}
-#if LWIP_IPV4
-cy_rslt_t cy_lwip_dhcp_renew(cy_lwip_nw_interface_t *iface)
-{
-    if(is_interface_valid(iface) != CY_RSLT_SUCCESS)
-    {
-        return CY_RSLT_LWIP_BAD_ARG;
-    }
-    /* Invalidate ARP entries */
-    netifapi_netif_common(IP_HANDLE(iface->role), (netifapi_void_fn) invalidate_all_arp_entries, NULL );
-
-
-    /*
-     * If LPA is enabled, invoke activity callback to resume the network stack,
-     * before invoking the lwip APIs that requires TCP Core lock.
-     */
-    if (activity_callback)
+    else
     {
-        activity_callback(true);
+        cy_lwip_unregister_ethertype_handler(EAPOL_PACKET_TYPE, CY_LWIP_STA_NW_INTERFACE);
+        cy_lwip_unregister_ethertype_handler(EAPOL_PACKET_TYPE, CY_LWIP_AP_NW_INTERFACE);
     }
 
-    /* DHCP renewal*/
-    netifapi_netif_common(IP_HANDLE(iface->role), (netifapi_void_fn)dhcp_renew, NULL);
-
-    cy_rtos_delay_milliseconds(DCHP_RENEWAL_DELAY_IN_MS);
-    return CY_RSLT_SUCCESS;
-}
-
-/**
- * Remove all ARP table entries of the specified netif.
- * @param netif points to a network interface
- */
-static void invalidate_all_arp_entries(struct netif *netif)
-{
-     /*free all the entries in arp list */
-    etharp_cleanup_netif(netif);
+    return result;
 }
-#endif
 
-/* Used to register callback for EAPOL packets */
-cy_rslt_t cy_wifimwcore_eapol_register_receive_handler( cy_wifimwcore_eapol_packet_handler_t eapol_packet_handler )
-{
-    internal_eapol_packet_handler = eapol_packet_handler;
-    return CY_RSLT_SUCCESS;
-}
 
-static void internal_ip_change_callback (struct netif *netif)
+/*
+ * This function returns the interface added for the given WHD interface, in constant time.
+ */
+static nw_interface_entry_t *find_nw_interface(whd_interface_t whd_iface)
 {
-    /* notify wcm about ip change */
-    if(ip_change_callback != NULL)
+    if ((whd_iface == NULL) || (whd_iface->ifidx >= CY_LWIP_MAX_NW_INTERFACE))
     {
-        ip_change_callback(NULL);
+        return NULL;
     }
+    return nw_interface_lookup[whd_iface->ifidx];
 }
 
-static bool is_interface_added(cy_lwip_nw_interface_role_t role)
+/*
+ * This function returns the interface added for the given WHD interface and role.
+ */
+static nw_interface_entry_t *get_nw_interface(cy_lwip_nw_interface_t *iface)
 {
-    return (ip_networking_inited[((uint8_t)role)&3]);
-}
+    nw_interface_entry_t *nw_interface = find_nw_interface(iface->whd_iface);
 
-static bool is_network_up(cy_lwip_nw_interface_role_t role)
-{
-    return (ip_up[((uint8_t)role)&3]);
+    if ((nw_interface == NULL) || (nw_interface->role != iface->role))
+    {
+        return NULL;
+    }
+    return nw_interface;
 }
 
 static cy_rslt_t is_interface_valid(cy_lwip_nw_interface_t *iface)
@@ -1030,6 +4438,11 @@ static cy_rslt_t is_interface_valid(cy_lwip_nw_interface_t *iface)
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
+    if((iface->whd_iface == NULL) || (iface->whd_iface->ifidx >= CY_LWIP_MAX_NW_INTERFACE))
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
     return CY_RSLT_SUCCESS;
 }
 
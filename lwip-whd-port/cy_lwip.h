@@ -73,6 +73,85 @@ typedef enum
     CY_NETWORK_ACTIVITY_RX = 1   /**< RX network activity  */
 } cy_network_activity_type_t;
 
+/**
+ * Enumeration of actions taken by an RX filter rule
+ */
+typedef enum
+{
+    CY_LWIP_RX_FILTER_ACTION_PASS  = 0,  /**< Deliver the packet to lwIP                       */
+    CY_LWIP_RX_FILTER_ACTION_DROP  = 1,  /**< Count the packet and drop it before lwIP         */
+    CY_LWIP_RX_FILTER_ACTION_COUNT = 2   /**< Count the packet and deliver it to lwIP          */
+} cy_lwip_rx_filter_action_t;
+
+/**
+ * Enumeration of WMM access categories used by the TX scheduler
+ */
+typedef enum
+{
+    CY_LWIP_TX_AC_BE  = 0,  /**< Best effort, DSCP class selectors 0 and 3 and non-IP packets */
+    CY_LWIP_TX_AC_BK  = 1,  /**< Background, DSCP class selectors 1 and 2                      */
+    CY_LWIP_TX_AC_VI  = 2,  /**< Video, DSCP class selectors 4 and 5                           */
+    CY_LWIP_TX_AC_VO  = 3,  /**< Voice, DSCP class selectors 6 and 7                           */
+    CY_LWIP_TX_AC_MAX = 4   /**< Number of access categories                                   */
+} cy_lwip_tx_ac_t;
+
+/**
+ * Enumeration of TX scheduler dequeue modes
+ */
+typedef enum
+{
+    CY_LWIP_TX_SCHED_MODE_STRICT   = 0,  /**< Always serve the highest priority queue which is not empty       */
+    CY_LWIP_TX_SCHED_MODE_WEIGHTED = 1   /**< Serve each queue up to its weight in packets per round, by priority */
+} cy_lwip_tx_sched_mode_t;
+
+/**
+ * Enumeration of the network interface changes reported by \ref cy_lwip_ip_change_event_t
+ */
+typedef enum
+{
+    CY_LWIP_IP_CHANGE_IPV4_ADDRESS = 0,  /**< IPv4 address, netmask or gateway changed        */
+    CY_LWIP_IP_CHANGE_IPV6_ADDRESS = 1,  /**< IPv6 address or state of an address slot changed */
+    CY_LWIP_IP_CHANGE_LINK         = 2,  /**< Network link layer brought up or down           */
+    CY_LWIP_IP_CHANGE_STATUS       = 3,  /**< Network interface brought up or down            */
+    CY_LWIP_IP_CHANGE_REMOVED      = 4   /**< Network interface removed                       */
+} cy_lwip_ip_change_type_t;
+
+/**
+ * Enumeration of the ARP cache handling of a DHCP renewal, see \ref cy_lwip_dhcp_renew_async
+ */
+typedef enum
+{
+    CY_LWIP_DHCP_RENEW_ARP_FLUSH      = 0,  /**< Remove all the ARP entries of the interface, as \ref cy_lwip_dhcp_renew does */
+    CY_LWIP_DHCP_RENEW_ARP_REVALIDATE = 1   /**< Keep the ARP entries, probe the gateway and the active peers by unicast     */
+} cy_lwip_dhcp_renew_mode_t;
+
+/**
+ * Enumeration of the operations timed by the phase timing records
+ */
+typedef enum
+{
+    CY_LWIP_PHASE_OP_NETWORK_UP   = 0,  /**< \ref cy_lwip_network_up or \ref cy_lwip_network_up_async */
+    CY_LWIP_PHASE_OP_NETWORK_DOWN = 1   /**< \ref cy_lwip_network_down                                 */
+} cy_lwip_phase_op_t;
+
+/**
+ * Enumeration of the phases of a network bring up or tear down
+ */
+typedef enum
+{
+    CY_LWIP_PHASE_NETIF_UP          = 0,  /**< Network interface brought up                                */
+    CY_LWIP_PHASE_DHCP_SERVER_START = 1,  /**< Internal DHCP server started, AP interface only             */
+    CY_LWIP_PHASE_LINK_UP           = 2,  /**< Network link layer brought up                               */
+    CY_LWIP_PHASE_IPV6_DAD          = 3,  /**< Duplicate address detection of the IPv6 link-local address  */
+    CY_LWIP_PHASE_DHCP              = 4,  /**< IPv4 address acquisition through DHCP                       */
+    CY_LWIP_PHASE_AUTOIP            = 5,  /**< IPv4 address acquisition through AutoIP after DHCP failed   */
+    CY_LWIP_PHASE_DHCP_STOP         = 6,  /**< DHCP release, including DHCP_STOP_DELAY_IN_MS, or AutoIP stop */
+    CY_LWIP_PHASE_DHCP_SERVER_STOP  = 7,  /**< Internal DHCP server stopped, AP interface only             */
+    CY_LWIP_PHASE_LINK_DOWN         = 8,  /**< Network link layer brought down                             */
+    CY_LWIP_PHASE_NETIF_DOWN        = 9,  /**< Network interface brought down                              */
+    CY_LWIP_PHASE_MAX               = 10  /**< Number of phases                                            */
+} cy_lwip_phase_t;
+
 /** \} group_lwip_whd_enums */
 
 /**
@@ -98,6 +177,240 @@ typedef struct ip_static
     ip_addr_t gateway; /**< The default gateway for network traffic */
 } ip_static_addr_t;
 
+/** RX filter rule matches packets sent to a unicast MAC address */
+#define CY_LWIP_RX_FILTER_MAC_UNICAST      (0x01)
+/** RX filter rule matches packets sent to a multicast MAC address */
+#define CY_LWIP_RX_FILTER_MAC_MULTICAST    (0x02)
+/** RX filter rule matches packets sent to the broadcast MAC address */
+#define CY_LWIP_RX_FILTER_MAC_BROADCAST    (0x04)
+/** RX filter rule matches packets sent to any MAC address */
+#define CY_LWIP_RX_FILTER_MAC_ANY          (CY_LWIP_RX_FILTER_MAC_UNICAST | CY_LWIP_RX_FILTER_MAC_MULTICAST | CY_LWIP_RX_FILTER_MAC_BROADCAST)
+
+/**
+ * Structure used to describe an RX filter rule passed to \ref cy_lwip_rx_filter_set_rules.
+ * A field set to 0 matches any value. The first rule matching a packet decides its fate.
+ */
+typedef struct
+{
+    uint8_t                    mac_class;    /**< Destination MAC classes, combination of CY_LWIP_RX_FILTER_MAC_xxx */
+    uint16_t                   ethertype;    /**< Ethertype in host byte order, 0 for any */
+    uint8_t                    ip_protocol;  /**< IPv4 protocol or IPv6 next header, 0 for any */
+    uint16_t                   dst_port;     /**< UDP or TCP destination port in host byte order, 0 for any */
+    cy_lwip_rx_filter_action_t action;       /**< Action taken on matching packets */
+} cy_lwip_rx_filter_rule_t;
+
+/** Network bring up completes once an IPv4 address is usable */
+#define CY_LWIP_NETWORK_UP_WAIT_IPV4       (0x01)
+/** Network bring up completes once duplicate address detection of the IPv6 link-local address is over */
+#define CY_LWIP_NETWORK_UP_WAIT_IPV6       (0x02)
+/** Network bring up completes once the addresses of all the enabled IP versions are usable */
+#define CY_LWIP_NETWORK_UP_WAIT_ALL        (CY_LWIP_NETWORK_UP_WAIT_IPV4 | CY_LWIP_NETWORK_UP_WAIT_IPV6)
+
+/**
+ * Network bring up completion callback function prototype, see \ref cy_lwip_network_up_async.
+ * The callback is invoked with the TCP/IP core lock held and must not block.
+ *
+ * @param[in] iface   Network interface passed to \ref cy_lwip_network_up_async.
+ * @param[in] result  CY_RSLT_SUCCESS if the network is up, failure code otherwise.
+ * @param[in] arg     User argument passed in \ref cy_lwip_network_up_params_t.
+ */
+typedef void (*cy_lwip_network_up_callback_t)(cy_lwip_nw_interface_t *iface, cy_rslt_t result, void *arg);
+
+/**
+ * Structure used to pass the parameters of \ref cy_lwip_network_up_async
+ */
+typedef struct
+{
+    cy_lwip_network_up_callback_t callback;  /**< Invoked once the bring up completes, fails or times out */
+    void                          *arg;      /**< User argument passed to the callback */
+    uint8_t                       wait_for;  /**< Address families to wait for, combination of CY_LWIP_NETWORK_UP_WAIT_xxx, 0 for all */
+} cy_lwip_network_up_params_t;
+
+/**
+ * DHCP renewal completion callback function prototype, see \ref cy_lwip_dhcp_renew_async.
+ * The callback is invoked with the TCP/IP core lock held and must not block.
+ *
+ * @param[in] iface   Network interface passed to \ref cy_lwip_dhcp_renew_async.
+ * @param[in] result  CY_RSLT_SUCCESS if the renewal completed, failure code otherwise.
+ * @param[in] arg     User argument passed in \ref cy_lwip_dhcp_renew_params_t.
+ */
+typedef void (*cy_lwip_dhcp_renew_callback_t)(cy_lwip_nw_interface_t *iface, cy_rslt_t result, void *arg);
+
+/**
+ * Structure used to pass the parameters of \ref cy_lwip_dhcp_renew_async
+ */
+typedef struct
+{
+    cy_lwip_dhcp_renew_mode_t     mode;      /**< Handling of the ARP cache of the interface */
+    cy_lwip_dhcp_renew_callback_t callback;  /**< Invoked once the renewal completes or times out */
+    void                          *arg;      /**< User argument passed to the callback */
+} cy_lwip_dhcp_renew_params_t;
+
+/**
+ * Structure used to store a DHCP lease obtained on a STA interface, see \ref cy_lwip_dhcp_lease_cache_configure
+ */
+typedef struct
+{
+    uint8_t  ssid[32];    /**< SSID of the network the lease was obtained on */
+    uint8_t  ssid_len;    /**< Length of the SSID */
+    uint8_t  bssid[6];    /**< BSSID of the AP the lease was obtained through */
+    uint32_t ip_addr;     /**< Leased IPv4 address in network byte order */
+    uint32_t netmask;     /**< Netmask in network byte order */
+    uint32_t gateway;     /**< Default gateway in network byte order */
+    uint32_t lease_time;  /**< Lease duration in seconds granted by the DHCP server */
+    uint32_t obtained;    /**< Time the lease was bound, in seconds of the clock of \ref cy_lwip_dhcp_lease_cache_config_t */
+} cy_lwip_dhcp_lease_t;
+
+/**
+ * DHCP lease cache clock function prototype. Returns the current time in seconds from a clock
+ * which keeps running across resets, such as an RTC, so that the restored leases can be aged.
+ * The callback is invoked with the TCP/IP core lock held.
+ *
+ * @param[in] arg     User argument passed in \ref cy_lwip_dhcp_lease_cache_config_t.
+ *
+ * @return Current time in seconds.
+ */
+typedef uint32_t (*cy_lwip_dhcp_lease_time_t)(void *arg);
+
+/**
+ * DHCP lease cache load function prototype. Invoked by \ref cy_lwip_dhcp_lease_cache_configure
+ * to restore the leases saved by a previous run.
+ *
+ * @param[out] leases     Array to fill with the saved leases, most recently used first.
+ * @param[in]  max_count  Number of entries in the array.
+ * @param[out] count      Number of leases restored, 0 if none were saved.
+ * @param[in]  arg        User argument passed in \ref cy_lwip_dhcp_lease_cache_config_t.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+typedef cy_rslt_t (*cy_lwip_dhcp_lease_load_t)(cy_lwip_dhcp_lease_t *leases, uint32_t max_count, uint32_t *count, void *arg);
+
+/**
+ * DHCP lease cache save function prototype. Invoked whenever the content of the cache changes.
+ * The callback is invoked with the TCP/IP core lock held: slow storage writes should be deferred
+ * to another thread.
+ *
+ * @param[in] leases  Cached leases, most recently used first.
+ * @param[in] count   Number of cached leases.
+ * @param[in] arg     User argument passed in \ref cy_lwip_dhcp_lease_cache_config_t.
+ */
+typedef void (*cy_lwip_dhcp_lease_save_t)(const cy_lwip_dhcp_lease_t *leases, uint32_t count, void *arg);
+
+/**
+ * Structure used to configure the DHCP lease cache with \ref cy_lwip_dhcp_lease_cache_configure
+ */
+typedef struct
+{
+    cy_lwip_dhcp_lease_load_t load;                /**< Restores the saved leases, NULL if not persisted */
+    cy_lwip_dhcp_lease_save_t save;                /**< Saves the leases, NULL if not persisted */
+    cy_lwip_dhcp_lease_time_t get_time;            /**< Clock the leases are aged with, NULL for the system uptime. Required for the restored leases to be used */
+    void                      *arg;                /**< User argument passed to the callbacks */
+    bool                      use_cached_address;  /**< Assign the cached address while the DHCP server verifies it */
+} cy_lwip_dhcp_lease_cache_config_t;
+
+/**
+ * Structure used to configure the internal DHCP server of an AP interface with \ref cy_lwip_dhcp_server_configure.
+ * A field set to 0 takes its default value.
+ */
+typedef struct
+{
+    uint32_t lease_time;    /**< Lease duration in seconds granted to the clients, 0 for one day */
+    bool     rapid_commit;  /**< Acknowledge a DISCOVER carrying the rapid commit option (RFC 4039) right away, so that the client binds after two messages instead of four */
+    uint16_t max_leases;    /**< Number of clients holding a lease at once, 0 for CY_LWIP_DHCP_SERVER_MAX_LEASES. The lease table is allocated at server start, 48 to 96 bytes per lease. Capped by the number of host addresses of the subnet */
+    bool     static_arp;    /**< Add a static ARP entry for each client when its lease is acknowledged, and remove it when the lease expires, is released or is reclaimed. Requires ETHARP_SUPPORT_STATIC_ENTRIES. At most CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX entries (half of ARP_TABLE_SIZE by default) are added across all the servers, the other clients are resolved by ARP as usual */
+} cy_lwip_dhcp_server_config_t;
+
+/**
+ * Structure used to report the counters of a DHCP server with \ref cy_lwip_dhcp_server_get_stats.
+ * The counters start from 0 each time the server starts.
+ */
+typedef struct
+{
+    uint32_t discover;         /**< DISCOVER messages received */
+    uint32_t request;          /**< REQUEST messages received */
+    uint32_t release;          /**< RELEASE messages received */
+    uint32_t decline;          /**< DECLINE messages received */
+    uint32_t offer;            /**< OFFER replies sent */
+    uint32_t ack;              /**< ACK replies sent */
+    uint32_t nak;              /**< NAK replies sent */
+    uint32_t dropped;          /**< Messages ignored: malformed, of an unknown type or for another server */
+    uint32_t pool_exhausted;   /**< DISCOVER messages left unanswered because no address was left in the pool */
+    uint32_t reply_buffer_exhausted; /**< Replies dropped because all the reply buffers were in flight. The messages are still handled */
+} cy_lwip_dhcp_server_stats_t;
+
+/**
+ * Structure used to configure the TX scheduler with \ref cy_lwip_tx_sched_configure.
+ * Arrays are indexed by \ref cy_lwip_tx_ac_t.
+ */
+typedef struct
+{
+    cy_lwip_tx_sched_mode_t mode;                           /**< Dequeue mode */
+    uint8_t                 weight[CY_LWIP_TX_AC_MAX];      /**< Packets sent per round in weighted mode, at least 1 */
+    uint16_t                depth_limit[CY_LWIP_TX_AC_MAX]; /**< Maximum number of queued packets, at most CY_LWIP_TX_SCHED_QUEUE_SIZE */
+} cy_lwip_tx_sched_config_t;
+
+/**
+ * Structure used to return the statistics of a TX scheduler queue
+ */
+typedef struct
+{
+    uint32_t enqueued;   /**< Number of packets queued */
+    uint32_t sent;       /**< Number of packets handed to WHD */
+    uint32_t dropped;    /**< Number of packets dropped because the queue was full, or the interface was not ready and the TX hold queue was full */
+    uint16_t depth;      /**< Number of packets currently queued */
+    uint16_t max_depth;  /**< Highest number of packets queued at once */
+} cy_lwip_tx_sched_stats_t;
+
+/**
+ * Structure used to describe a change of a network interface to the IP change callbacks,
+ * see \ref cy_lwip_ip_change_subscribe
+ */
+typedef struct
+{
+    cy_lwip_nw_interface_role_t role;  /**< Role of the network interface */
+    cy_lwip_ip_change_type_t    type;  /**< Kind of change, selects the member of data */
+    union
+    {
+        bool up;                        /**< New state, CY_LWIP_IP_CHANGE_LINK and CY_LWIP_IP_CHANGE_STATUS */
+        struct
+        {
+            ip_addr_t old_addr;         /**< Previous IPv4 address */
+            ip_addr_t new_addr;         /**< New IPv4 address */
+            ip_addr_t old_netmask;      /**< Previous netmask */
+            ip_addr_t new_netmask;      /**< New netmask */
+            ip_addr_t old_gateway;      /**< Previous default gateway */
+            ip_addr_t new_gateway;      /**< New default gateway */
+        } ipv4;                         /**< CY_LWIP_IP_CHANGE_IPV4_ADDRESS */
+        struct
+        {
+            int8_t    index;            /**< Address slot of the interface */
+            uint8_t   old_state;        /**< Previous state of the slot, LwIP IP6_ADDR_xxx */
+            uint8_t   new_state;        /**< New state of the slot, LwIP IP6_ADDR_xxx */
+            ip_addr_t old_addr;         /**< Previous IPv6 address of the slot */
+            ip_addr_t new_addr;         /**< New IPv6 address of the slot */
+        } ipv6;                         /**< CY_LWIP_IP_CHANGE_IPV6_ADDRESS */
+    } data;                             /**< Old and new values */
+} cy_lwip_ip_change_event_t;
+
+/** Phase time of a phase that did not run, or did not end before the operation completed */
+#define CY_LWIP_PHASE_NOT_RUN              (0xFFFFFFFFUL)
+
+/**
+ * Structure used to return the timing record of a network bring up or tear down,
+ * see \ref cy_lwip_get_phase_timing. Phase times are in milliseconds since start_time.
+ */
+typedef struct
+{
+    cy_lwip_phase_op_t          op;                              /**< Operation timed */
+    cy_lwip_nw_interface_role_t role;                            /**< Role of the network interface */
+    cy_rslt_t                   result;                          /**< Outcome of the operation */
+    uint32_t                    start_time;                      /**< Time the operation was called at, in milliseconds, see sys_now() */
+    uint32_t                    duration;                        /**< Time until the operation completed, in milliseconds */
+    uint32_t                    phase_start[CY_LWIP_PHASE_MAX];  /**< Start time of each phase, CY_LWIP_PHASE_NOT_RUN if not run */
+    uint32_t                    phase_end[CY_LWIP_PHASE_MAX];    /**< End time of each phase, CY_LWIP_PHASE_NOT_RUN if not ended */
+    bool                        dhcp_lease_cached;               /**< The DHCP phase ended with the address of a cached lease, before the DHCP server acknowledged it */
+} cy_lwip_phase_record_t;
+
 /** \} group_lwip_whd_port_structures */
 
 /**
@@ -112,6 +425,9 @@ typedef struct ip_static
  * configures the optional static IP address and registers to IP change callback.
  *
  * \note static IP address is mandatory for AP interface.
+ * \note Several interfaces of the same role can be added, each with its own WHD interface,
+ *       for example a P2P group owner as an AP interface. At most CY_LWIP_MAX_NW_INTERFACE
+ *       interfaces can be added and WHD interface indexes must be below that limit.
  *
  * @param[in] iface      Network interface to be added.
  * @param[in] ipaddr     IPv4/IPv6 address information associated with the interface.
@@ -131,6 +447,7 @@ cy_rslt_t cy_lwip_remove_interface(cy_lwip_nw_interface_t *iface);
 
 /**
  * Return the LwIP network interface for the given network interface role.
+ * If several interfaces of this role were added, the first one added is returned.
  *
  * @param[in] role      Interface role.
  *
@@ -138,9 +455,19 @@ cy_rslt_t cy_lwip_remove_interface(cy_lwip_nw_interface_t *iface);
  */
 struct netif* cy_lwip_get_interface(cy_lwip_nw_interface_role_t role);
 
+/**
+ * Return the LwIP network interface added for the given WHD interface.
+ *
+ * @param[in] whd_iface WHD interface.
+ *
+ * @return netif structure of the WHD interface, null if no interface was added for it.
+ */
+struct netif* cy_lwip_get_interface_by_whd_iface(whd_interface_t whd_iface);
+
 /**
  * This function brings up the network link layer and
- *  and starts DHCP if required
+ *  and starts DHCP if required. The calling thread is blocked
+ *  until the bring up completes, see \ref cy_lwip_network_up_async.
  *
  * @param[in] iface      Network interface to be brought up.
  *
@@ -148,6 +475,25 @@ struct netif* cy_lwip_get_interface(cy_lwip_nw_interface_role_t role);
  */
 cy_rslt_t cy_lwip_network_up(cy_lwip_nw_interface_t *iface);
 
+/**
+ * This function brings up the network link layer and starts DHCP if required, without
+ * waiting for the addresses to be acquired. The progress is driven by LwIP interface events
+ * and the result is reported through the callback passed in the parameters: CY_RSLT_SUCCESS
+ * once the network is up, CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT if no IPv4 address could be
+ * obtained, or CY_RSLT_LWIP_NETWORK_UP_ABORTED if \ref cy_lwip_network_down is called first.
+ * The callback is not invoked when this function returns a failure code.
+ *
+ * DHCP and the duplicate address detection of the IPv6 link-local address run in parallel.
+ * The bring up completes as soon as the address families selected by wait_for are usable;
+ * the acquisition of the other family carries on in LwIP after the callback is invoked.
+ *
+ * @param[in] iface      Network interface to be brought up.
+ * @param[in] params     Bring up parameters.
+ *
+ * @return CY_RSLT_SUCCESS if the bring up was started, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_network_up_async(cy_lwip_nw_interface_t *iface, const cy_lwip_network_up_params_t *params);
+
 /**
  * This function brings down the network interface, brings down the network link layer
  * and stops DHCP
@@ -168,6 +514,80 @@ cy_rslt_t cy_lwip_network_down(cy_lwip_nw_interface_t *iface);
  * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
  */
 cy_rslt_t cy_lwip_dhcp_renew(cy_lwip_nw_interface_t *iface);
+
+/**
+ * This function renews the DHCP lease and refreshes the ARP cache of the interface, then returns.
+ * The completion is reported through the callback in \ref cy_lwip_dhcp_renew_params_t.
+ * This function is typically used after a handshake failure or a roam within the same network
+ * on a STA interface.
+ *
+ * With \ref CY_LWIP_DHCP_RENEW_ARP_REVALIDATE, the ARP entries are kept and an ARP request is sent
+ * by unicast to the MAC address of the gateway and of each peer in the ARP cache. Peers which do
+ * not answer within CY_LWIP_ARP_REVALIDATE_TIMEOUT_MS are asked again by broadcast. Traffic to the
+ * peers goes on without waiting for their address to be resolved again. The static ARP entry of the
+ * gateway installed with CY_LWIP_ANNOUNCE_ON_BIND is removed, so that the gateway is learned again,
+ * and the static entries of the DHCP server leases are not probed.
+ *
+ * The renewal completes once the DHCP server acknowledged the lease, if it was obtained through
+ * DHCP, and the ARP probes are over. It fails with CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT if this takes
+ * more than CY_LWIP_DHCP_RENEW_TIMEOUT_MS, and with CY_RSLT_LWIP_DHCP_RENEW_ABORTED if the network
+ * is brought down with \ref cy_lwip_network_down in the meantime.
+ *
+ * @param[in] iface      LwIP Interface to be renewed.
+ * @param[in] params     Renewal parameters, @ref cy_lwip_dhcp_renew_params_t.
+ *
+ * @return CY_RSLT_SUCCESS if the renewal was started, CY_RSLT_LWIP_DHCP_RENEW_FAILED if the request to
+ *         renew the lease could not be sent, in which case the callback is not invoked, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_dhcp_renew_async(cy_lwip_nw_interface_t *iface, const cy_lwip_dhcp_renew_params_t *params);
+
+/**
+ * This function configures the DHCP lease cache and restores the saved leases through the load callback.
+ *
+ * The leases obtained by the DHCP client of a STA interface are cached, keyed by the SSID and BSSID
+ * of the network. When a lease which has not ended is cached for the same SSID and BSSID,
+ * \ref cy_lwip_network_up requests it again with an INIT-REBOOT DHCPREQUEST instead of going through
+ * DHCPDISCOVER and DHCPOFFER. If use_cached_address is set, the address is assigned to the interface
+ * and the bring up completes without waiting for the server to acknowledge it; the address is removed
+ * if the server rejects it. Leases are timed from their first bind, renewals are not accounted for.
+ * The restored leases are only used when get_time is set, as their age is unknown otherwise. Changing
+ * get_time empties the cache. The cache works in RAM without calling this function.
+ *
+ * The cache holds CY_LWIP_DHCP_LEASE_CACHE_SIZE leases, 0 by default, which disables it.
+ *
+ * @param[in] config     Lease cache configuration.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_dhcp_lease_cache_configure(const cy_lwip_dhcp_lease_cache_config_t *config);
+
+/**
+ * This function removes all the leases from the DHCP lease cache.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_dhcp_lease_cache_clear(void);
+
+/**
+ * This function configures the internal DHCP server of an AP interface.
+ * The configuration takes effect the next time the network is brought up on the interface.
+ *
+ * @param[in] iface      LwIP AP Interface.
+ * @param[in] config     DHCP server configuration.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_dhcp_server_configure(cy_lwip_nw_interface_t *iface, const cy_lwip_dhcp_server_config_t *config);
+
+/**
+ * This function returns the counters of the internal DHCP server of an AP interface.
+ *
+ * @param[in]  iface     LwIP AP Interface.
+ * @param[out] stats     DHCP server counters.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_dhcp_server_get_stats(cy_lwip_nw_interface_t *iface, cy_lwip_dhcp_server_stats_t *stats);
 #endif
 /**
  *
@@ -183,6 +603,23 @@ cy_rslt_t cy_lwip_dhcp_renew(cy_lwip_nw_interface_t *iface);
  */
 extern void cy_network_process_ethernet_data(whd_interface_t iface, whd_buffer_t buf);
 
+/**
+ *
+ * This function takes a set of packets received on the same interface from the radio driver
+ * and passes them into the lwIP stack. Unlike \ref cy_network_process_ethernet_data, the packets
+ * are handed to lwIP under a single TCP/IP core lock acquisition. The lock is held for at most
+ * CY_LWIP_RX_BATCH_MAX packets or CY_LWIP_RX_BATCH_TIME_BUDGET_MS milliseconds at a time.
+ * Packets which are not accepted by lwIP are freed (dropped).
+ *
+ * \note This function must not be called from interrupt context.
+ *
+ * @param[in] iface WiFi interface on which all the packets were received.
+ * @param[in] bufs  Array of packets received from the radio driver.
+ * @param[in] count Number of packets in the array.
+ *
+ */
+extern void cy_network_process_ethernet_data_batch(whd_interface_t iface, whd_buffer_t *bufs, uint32_t count);
+
 /**
  * Network activity callback function prototype
  * Callback function which can be registered/unregistered for any network activity
@@ -193,10 +630,132 @@ typedef void (*cy_network_activity_event_callback_t)(bool callback_arg);
 /**
  * IP change callback function prototype
  * Callback function which can be registered to receive IP changes
- * needs to be of this prototype
+ * needs to be of this prototype. data points to the \ref cy_lwip_ip_change_event_t
+ * describing the change.
  */
 typedef void (*cy_lwip_ip_change_callback_t)(void *data);
 
+/**
+ * IP change event callback function prototype, see \ref cy_lwip_ip_change_subscribe.
+ * The callback is invoked with the TCP/IP core lock held and must not block.
+ *
+ * @param[in] event  Change of the network interface, valid during the call only.
+ * @param[in] arg    User argument passed to \ref cy_lwip_ip_change_subscribe.
+ */
+typedef void (*cy_lwip_ip_change_event_callback_t)(const cy_lwip_ip_change_event_t *event, void *arg);
+
+/**
+ * Ethertype handler function prototype. Packets received from WHD with a registered
+ * ethertype are redirected to the handler instead of being passed to lwIP.
+ * The buffer should be freed by the handler.
+ *
+ * @param[in] whd_iface  WHD interface on which the packet was received.
+ * @param[in] buffer     Buffer received from WHD.
+ * @param[in] arg        User argument passed at registration.
+ */
+typedef void (*cy_lwip_ethertype_handler_t)(whd_interface_t whd_iface, whd_buffer_t buffer, void *arg);
+
+/**
+ * This function registers a handler for packets of the given ethertype received on
+ * interfaces of the given role. Registering a handler for an ethertype which already has
+ * one on that role replaces it. Lookup is done in a small open-addressed table of
+ * CY_LWIP_ETHERTYPE_HANDLER_TABLE_SIZE entries, so dispatch cost does not depend on the
+ * number of registered handlers.
+ *
+ * \note The handler is invoked in the context of the WHD thread and must not block.
+ *
+ * @param[in] ethertype  Ethertype in host byte order, for example 0x88CC for LLDP.
+ * @param[in] role       Interface role on which the handler applies.
+ * @param[in] handler    Handler to be invoked for matching packets.
+ * @param[in] arg        User argument passed to the handler.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_register_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role, cy_lwip_ethertype_handler_t handler, void *arg);
+
+/**
+ * This function removes the handler registered for the given ethertype and interface role.
+ * Packets of this ethertype are passed to lwIP afterwards, except EAPOL packets which are
+ * dropped when no handler is registered for them.
+ *
+ * @param[in] ethertype  Ethertype in host byte order.
+ * @param[in] role       Interface role on which the handler was registered.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_unregister_ethertype_handler(uint16_t ethertype, cy_lwip_nw_interface_role_t role);
+
+/**
+ * This function installs the RX filter rules of an interface role, replacing the previous ones.
+ * A rule set applies to every interface of the role, and so do its hit counters.
+ * Rules are compiled into a lookup table so that each received packet is evaluated with a few
+ * table probes before it reaches lwIP. Passing a count of 0 removes all the rules.
+ * The hit counters of the rules are reset. The new rules are compiled aside and apply to the packets
+ * received once the function returns; the packets received in the meantime are filtered by the
+ * previous rules.
+ *
+ * \note IPv6 packets are matched on the next header field of the fixed header only.
+ * \note Concurrent calls are serialized. The TCP/IP stack must be initialized.
+ *
+ * @param[in] role   Interface role on which the rules apply.
+ * @param[in] rules  Array of rules, evaluated in order.
+ * @param[in] count  Number of rules, at most CY_LWIP_RX_FILTER_MAX_RULES.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_rx_filter_set_rules(cy_lwip_nw_interface_role_t role, const cy_lwip_rx_filter_rule_t *rules, uint32_t count);
+
+/**
+ * This function returns the number of packets counted or dropped by an RX filter rule.
+ *
+ * @param[in]  role        Interface role on which the rule applies.
+ * @param[in]  rule_index  Index of the rule in the array passed to \ref cy_lwip_rx_filter_set_rules.
+ * @param[out] hits        Number of packets which matched the rule.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_rx_filter_get_hits(cy_lwip_nw_interface_role_t role, uint32_t rule_index, uint32_t *hits);
+
+/**
+ * This function configures the TX scheduler. Outgoing packets are queued per WMM access
+ * category, classified from the DSCP of their IPv4 ToS or IPv6 traffic class, and handed
+ * to WHD in strict priority or weighted order. By default, the queues are served in weighted
+ * mode with weights 8, 4, 2 and 1 for voice, video, best effort and background.
+ *
+ * \note Requires the CY_LWIP_TX_SCHEDULER macro to be enabled.
+ *
+ * @param[in] config  Scheduler configuration.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_tx_sched_configure(const cy_lwip_tx_sched_config_t *config);
+
+/**
+ * This function returns the statistics of a TX scheduler queue.
+ *
+ * \note Requires the CY_LWIP_TX_SCHEDULER macro to be enabled.
+ *
+ * @param[in]  ac     Access category of the queue.
+ * @param[out] stats  Statistics of the queue.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_tx_sched_get_stats(cy_lwip_tx_ac_t ac, cy_lwip_tx_sched_stats_t *stats);
+
+/**
+ * This function returns the timing records of the most recent network bring ups and tear downs,
+ * with the time spent in each of their phases.
+ *
+ * \note Requires the CY_LWIP_PHASE_TIMING macro to be enabled.
+ *
+ * @param[out] records    Array filled with the records, oldest first.
+ * @param[in]  max_count  Number of entries in the array.
+ * @param[out] count      Number of records returned.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_get_phase_timing(cy_lwip_phase_record_t *records, uint32_t max_count, uint32_t *count);
+
 /**
  * This function helps to register/unregister callback fn for any TX/RX packets.
  * Passing "NULL" as cb will deregister the activity callback
@@ -208,6 +767,8 @@ void cy_network_activity_register_cb(cy_network_activity_event_callback_t cb);
 
 /**
  * This function notifies network activity to Low Power Assistant(LPA) module.
+ * Notifications of the same activity type are coalesced: the registered callback is invoked
+ * at most once every CY_LWIP_ACTIVITY_NOTIFY_WINDOW_MS milliseconds.
  *
  * @param[in] activity_type Network activity type \ref cy_network_activity_type_t to be notified to Low Power Assistant(LPA) module.
  *
@@ -224,6 +785,33 @@ cy_rslt_t cy_network_activity_notify(cy_network_activity_type_t activity_type);
  */
 void cy_lwip_register_ip_change_cb(cy_lwip_ip_change_callback_t cb);
 
+/**
+ * This function subscribes a callback to the changes of the network interfaces: IPv4
+ * address, netmask and gateway, IPv6 address slot state, link and interface status, and
+ * interface removal. Unlike the callback registered with \ref cy_lwip_register_ip_change_cb,
+ * which is not invoked for link, netmask and gateway changes, subscribers receive every change.
+ *
+ * \note Subscribers are invoked with the TCP/IP core lock held, in the TCP/IP thread or in the
+ *       thread which changed the interface. They must not block nor call functions which take
+ *       the core lock.
+ *
+ * @param[in] cb   IP change event callback function.
+ * @param[in] arg  User argument passed to the callback.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_ip_change_subscribe(cy_lwip_ip_change_event_callback_t cb, void *arg);
+
+/**
+ * This function removes a subscription made with \ref cy_lwip_ip_change_subscribe.
+ *
+ * @param[in] cb   IP change event callback function.
+ * @param[in] arg  User argument passed to \ref cy_lwip_ip_change_subscribe.
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+cy_rslt_t cy_lwip_ip_change_unsubscribe(cy_lwip_ip_change_event_callback_t cb, void *arg);
+
 
 /** \} group_lwip_whd_port_functions */
 #ifdef __cplusplus
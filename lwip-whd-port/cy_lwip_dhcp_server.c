@@ -39,6 +39,9 @@
 #include "lwip/api.h"
 #include "lwip/netif.h"
 #include "lwip/netifapi.h"
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "lwip/etharp.h"
 
 #if LWIP_IPV4
 
@@ -47,6 +50,8 @@
 #include "cyabs_rtos.h"
 #include "cy_lwip_log.h"
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
 
 /******************************************************
  *                      Macros
@@ -68,24 +73,75 @@
 #define ULONG_MAX_STR                           "4294967295"
 #define ULONG_MIN_STR                           "0000000000"
 
-#ifndef DHCP_IP_ADDRESS_CACHE_MAX
-#define DHCP_IP_ADDRESS_CACHE_MAX               (5)
+/* Maximum number of addresses in the pool, which holds the host addresses of the subnet */
+#ifndef DHCP_ADDRESS_POOL_MAX
+#define DHCP_ADDRESS_POOL_MAX                   (254)
 #endif
 
+#define DHCP_LEASE_TIME_S                       (86400)  /* Default lease time, one day */
+#define DHCP_OFFER_HOLD_TIME_S                  (60)     /* Time an offered address is kept for the client */
+
+/* Time declined addresses are kept out of the pool, see DHCP_DECLINE_QUARANTINE_MAX */
+#ifndef DHCP_DECLINE_QUARANTINE_TIME_S
+#define DHCP_DECLINE_QUARANTINE_TIME_S          (3600)
+#endif
+
+#define DHCP_LEASE_SLOT_EMPTY                   (0)
+#define DHCP_LEASE_SLOT_OFFERED                 (1)
+#define DHCP_LEASE_SLOT_BOUND                   (2)
+
+#define DHCP_LEASE_HASH(mac)                    (((((uint32_t)(mac)->octet[3] << 16) | ((uint32_t)(mac)->octet[4] << 8) | (mac)->octet[5]) ^ \
+                                                  ((uint32_t)(mac)->octet[2] << 5)) * 2654435761u)
+#define DHCP_LEASE_EXPIRED(lease, now)          ((int32_t)((now) - (lease)->expiry) >= 0)
+
+#define POOL_BIT_TEST(pool, host)               (((pool)[(host) >> 5] & (1u << ((host) & 31))) != 0)
+#define POOL_BIT_SET(pool, host)                ((pool)[(host) >> 5] |= (1u << ((host) & 31)))
+#define POOL_BIT_CLEAR(pool, host)              ((pool)[(host) >> 5] &= ~(1u << ((host) & 31)))
+
 #define DHCP_SERVER_RECEIVE_TIMEOUT             (500)
-#define ALLOCATE_PACKET_TIMEOUT                 (2000)
+
+/* Number of reply buffers reserved by each server. A request which finds them all in flight is dropped, the client retransmits */
+#ifndef DHCP_REPLY_BUFFER_COUNT
+#define DHCP_REPLY_BUFFER_COUNT                 (2)
+#endif
 
 /* BOOTP operations */
 #define BOOTP_OP_REQUEST                        (1)
 #define BOOTP_OP_REPLY                          (2)
 
+/* BOOTP flags */
+#define BOOTP_FLAG_BROADCAST                    (0x8000)
+
+/* Static ARP entries send unicast replies to clients without an address, and resolve the leased clients when static_arp is set */
+#define DHCP_STATIC_ARP_ENTRIES                 (LWIP_ARP && ETHARP_SUPPORT_STATIC_ENTRIES)
+#define DHCP_ARP_EXPIRY_CHECK_INTERVAL_MS       (10000)
+
+/* Static ARP entries are never evicted. Leave slots of the ARP table, shared with the other interfaces,
+ * to the gateway entries, the transient entries of unicast replies and the dynamic entries */
+#if DHCP_STATIC_ARP_ENTRIES && ( ( CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX < 1 ) || ( CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX > ( ARP_TABLE_SIZE - 4 ) ) )
+#error "CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX must be at least 1 and leave at least 4 entries of ARP_TABLE_SIZE free"
+#endif
+
+#if CY_LWIP_DHCP_SERVER_RAW_API
+/* The server runs in the TCP/IP thread, which holds the core lock */
+#define DHCP_SERVER_LOCK_CORE()
+#define DHCP_SERVER_UNLOCK_CORE()
+#else
+/* Taken by the server thread, which is why cy_lwip_dhcp_server_stop() lets the thread exit instead of terminating it */
+#define DHCP_SERVER_LOCK_CORE()                 LOCK_TCPIP_CORE()
+#define DHCP_SERVER_UNLOCK_CORE()               UNLOCK_TCPIP_CORE()
+#endif
+
 /* DHCP options */
 #define DHCP_SUBNETMASK_OPTION_CODE             (1)
+#define DHCP_ROUTER_OPTION_CODE                 (3)
+#define DHCP_DNS_SERVER_OPTION_CODE             (6)
 #define DHCP_MTU_OPTION_CODE                    (26)
 #define DHCP_REQUESTED_IP_ADDRESS_OPTION_CODE   (50)
 #define DHCP_LEASETIME_OPTION_CODE              (51)
 #define DHCP_MESSAGETYPE_OPTION_CODE            (53)
 #define DHCP_SERVER_IDENTIFIER_OPTION_CODE      (54)
+#define DHCP_RAPID_COMMIT_OPTION_CODE           (80)
 #define DHCP_WPAD_OPTION_CODE                   (252)
 #define DHCP_END_OPTION_CODE                    (255)
 
@@ -98,29 +154,39 @@
 #define DHCPNAK                                 (6)
 #define DHCPRELEASE                             (7)
 #define DHCPINFORM                              (8)
+
+/* Reply layout: fixed header up to the magic cookie, message type option, then the option template */
+#define DHCP_HEADER_FIXED_LENGTH                (offsetof(dhcp_header_t, options))
+#define DHCP_SERVER_IDENTIFIER_OPTION_LENGTH    (6)
+#define DHCP_REPLY_TEMPLATE_LENGTH              (DHCP_SERVER_IDENTIFIER_OPTION_LENGTH + 6 + 6 + 2 + sizeof(WPAD_SAMPLE_URL)-1 + 6 + 6 + 4 + 1)
+/* Longest reply: an ACK with the message type and rapid commit options followed by the template */
+#define DHCP_REPLY_MAX_LENGTH                   (DHCP_HEADER_FIXED_LENGTH + 5 + DHCP_REPLY_TEMPLATE_LENGTH)
+/* Room for the headers of the lower layers in front of the reply */
+#define DHCP_REPLY_BUFFER_SIZE                  (LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT) + DHCP_REPLY_MAX_LENGTH)
 #define CY_LWIP_PAYLOAD_MTU                     (1500)
-#define PHYSICAL_HEADER                         (44)
 
 /* UDP port numbers for DHCP server and client */
 #define IPPORT_DHCPS                            (67)
 #define IPPORT_DHCPC                            (68)
 #define WAIT_FOREVER                            ((uint32_t) 0xFFFFFFFF)
-#define MAX_UDP_PAYLOAD_SIZE                    (CY_LWIP_PAYLOAD_MTU - UDP_HLEN - IP_HLEN - PHYSICAL_HEADER)
 #define CY_DHCP_MAX_MUTEX_WAIT_TIME_MS          (120000)
 #define WPAD_SAMPLE_URL                         "http://xxx.xxx.xxx.xxx/wpad.dat"
 
 /******************************************************
  *               Variable Definitions
  ******************************************************/
-static const uint8_t mtu_option_buff[]             = { DHCP_MTU_OPTION_CODE, 2, CY_LWIP_PAYLOAD_MTU>>8, CY_LWIP_PAYLOAD_MTU&0xff };
+
+#if DHCP_STATIC_ARP_ENTRIES
+/* Addresses with a static ARP entry for their lease, host byte order, 0 if unused. Shared by all the servers as they
+ * share the ARP table. Accessed with the core locked */
+static uint32_t dhcp_lease_arp_addr[ CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX ];
+#endif
 static const uint8_t dhcp_offer_option_buff[]      = { DHCP_MESSAGETYPE_OPTION_CODE, 1, DHCPOFFER };
 static const uint8_t dhcp_ack_option_buff[]        = { DHCP_MESSAGETYPE_OPTION_CODE, 1, DHCPACK };
 static const uint8_t dhcp_nak_option_buff[]        = { DHCP_MESSAGETYPE_OPTION_CODE, 1, DHCPNAK };
-static const uint8_t lease_time_option_buff[]      = { DHCP_LEASETIME_OPTION_CODE, 4, 0x00, 0x01, 0x51, 0x80 }; /* 1 day lease */
+static const uint8_t dhcp_ack_rapid_commit_option_buff[] = { DHCP_MESSAGETYPE_OPTION_CODE, 1, DHCPACK, DHCP_RAPID_COMMIT_OPTION_CODE, 0 };
 static const uint8_t dhcp_magic_cookie[]           = { 0x63, 0x82, 0x53, 0x63 };
-static const cy_lwip_mac_addr_t empty_cache        = { .octet = {0} };
 typedef struct netbuf cy_lwip_packet_t;
-static cy_mutex_t dhcp_mutex;
 
 /******************************************************
  *                   Enumerations
@@ -155,35 +221,89 @@ typedef struct
     /* as of RFC2131 it is variable length */
 } dhcp_header_t;
 
+/* Lease of an address of the pool to a client */
+typedef struct cy_lwip_dhcp_lease
+{
+    cy_lwip_mac_addr_t mac;              /* client MAC address */
+    uint32_t           ip_addr;          /* leased address, host byte order */
+    uint32_t           expiry;           /* server time the lease or offer ends, in seconds */
+    uint32_t           last_used;        /* server time of the last message from the client, in seconds */
+    uint8_t            state;            /* DHCP_LEASE_SLOT_xxx */
+    uint8_t            arp_entry;        /* a static ARP entry resolves the leased address */
+} dhcp_lease_t;
+
+/* The RAM cost of a lease documented with CY_LWIP_DHCP_SERVER_MAX_LEASES assumes 24-byte slots */
+typedef char dhcp_lease_size_check[ ( sizeof( dhcp_lease_t ) <= 24 ) ? 1 : -1 ];
+
+/* The reply template is stored in cy_lwip_dhcp_server_t, which only knows its length */
+typedef char dhcp_reply_template_length_check[ ( DHCP_REPLY_TEMPLATE_LENGTH == CY_LWIP_DHCP_REPLY_TEMPLATE_LENGTH ) ? 1 : -1 ];
+
+/* Reply buffer, handed to lwIP as a custom pbuf which comes back to the pool when freed */
+typedef struct
+{
+    struct pbuf_custom              pbuf;     /* first member: the pbuf freed is the buffer */
+    struct cy_lwip_dhcp_reply_pool  *pool;
+    bool                            in_use;
+    uint32_t                        memory[ ( DHCP_REPLY_BUFFER_SIZE + 3 ) / 4 ];
+} dhcp_reply_buffer_t;
+
+/* Reply buffers of a server. When the server stops with buffers still held by the stack or the driver,
+ * the pool is freed once the last of them comes back */
+typedef struct cy_lwip_dhcp_reply_pool
+{
+    uint8_t                         in_use;    /* buffers not returned yet */
+    bool                            orphaned;  /* the server stopped */
+    dhcp_reply_buffer_t             buffers[ DHCP_REPLY_BUFFER_COUNT ];
+    uint32_t                        scratch[ ( DHCP_REPLY_MAX_LENGTH + 3 ) / 4 ]; /* reply of a message handled while all the buffers are in flight */
+} dhcp_reply_pool_t;
+
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
 
 static const uint8_t* find_option (const dhcp_header_t* request, uint8_t option_num);
-static bool get_client_ip_address_from_cache (const cy_lwip_mac_addr_t* client_mac_address, cy_lwip_ip_address_t* client_ip_address);
-static cy_rslt_t add_client_to_cache (const cy_lwip_mac_addr_t* client_mac_address, const cy_lwip_ip_address_t* client_ip_address);
+static cy_rslt_t lease_table_init (cy_lwip_dhcp_server_t* server, uint32_t server_ip_addr, uint32_t netmask);
+static void lease_table_deinit (cy_lwip_dhcp_server_t* server);
+static uint32_t server_time (cy_lwip_dhcp_server_t* server);
+static dhcp_lease_t* lease_find (const cy_lwip_dhcp_server_t* server, const cy_lwip_mac_addr_t* client_mac_address);
+static dhcp_lease_t* lease_allocate (cy_lwip_dhcp_server_t* server, const cy_lwip_mac_addr_t* client_mac_address, uint32_t requested_ip_addr, uint32_t now);
+static void lease_remove (cy_lwip_dhcp_server_t* server, dhcp_lease_t* lease);
+static void quarantine_add (cy_lwip_dhcp_server_t* server, uint32_t ip_addr, uint32_t now);
+static void quarantine_expire (cy_lwip_dhcp_server_t* server, uint32_t now);
+static void lease_arp_entry_add (dhcp_lease_t* lease);
+static void lease_arp_entry_remove (dhcp_lease_t* lease);
+static void lease_arp_entries_expire (cy_lwip_dhcp_server_t* server, uint32_t now);
 static void ipv4_to_string (char* buffer, uint32_t ipv4_address);
+static cy_rslt_t reply_pool_init (cy_lwip_dhcp_server_t* server);
+static void reply_pool_deinit (cy_lwip_dhcp_server_t* server);
+static struct pbuf* reply_buffer_alloc (cy_lwip_dhcp_server_t* server);
+static void reply_buffer_free (struct pbuf* p);
+static struct pbuf* dhcp_server_handle (cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, uint16_t request_length);
+static void reply_template_init (cy_lwip_dhcp_server_t* server);
+static uint16_t reply_build (const cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, dhcp_header_t* reply_header, const uint8_t* leading_options, uint8_t leading_options_length, uint32_t your_ip_addr);
+static void lease_bind (const cy_lwip_dhcp_server_t* server, dhcp_lease_t* lease, uint32_t now);
+static uint32_t reply_destination (const cy_lwip_dhcp_server_t* server, const dhcp_header_t* reply_header, bool* arp_entry_added);
+static void reply_arp_entry_remove (uint32_t ip_addr);
+static uint16_t dhcp_server_process (cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, uint16_t request_length, dhcp_header_t* reply_header);
+#if CY_LWIP_DHCP_SERVER_RAW_API
+static void dhcp_server_recv (void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+static void dhcp_server_arp_timer (void *arg);
+#else
 static void cy_dhcp_thread_func (cy_thread_arg_t thread_input);
-static cy_rslt_t udp_create_socket(cy_lwip_udp_socket_t *socket, uint16_t port, cy_lwip_nw_interface_role_t interface);
+static cy_rslt_t udp_create_socket(cy_lwip_udp_socket_t *socket, uint16_t port, struct netif *netif);
 static cy_rslt_t udp_delete_socket(cy_lwip_udp_socket_t *socket);
 static cy_rslt_t udp_receive(cy_lwip_udp_socket_t *socket, cy_lwip_packet_t** packet, uint32_t timeout);
 static cy_rslt_t packet_get_data(cy_lwip_packet_t *packet, uint16_t offset, uint8_t** data, uint16_t* fragment_available_data_length, uint16_t *total_available_data_length);
-static cy_rslt_t packet_set_data_end(cy_lwip_packet_t *packet, uint8_t* data_end);
 static cy_rslt_t packet_delete(cy_lwip_packet_t* packet);
-static cy_rslt_t packet_create_udp(cy_lwip_packet_t** packet, uint8_t** data, uint16_t* available_space);
-static cy_rslt_t internal_packet_create(cy_lwip_packet_t** packet, uint16_t content_length, uint8_t** data, uint16_t* available_space);
-static cy_rslt_t cy_udp_send(cy_lwip_udp_socket_t* socket, const cy_lwip_ip_address_t* address, uint16_t port, cy_lwip_packet_t* packet);
-static cy_rslt_t internal_udp_send(struct netconn* handler, cy_lwip_packet_t* packet, cy_lwip_nw_interface_role_t interface);
+static cy_rslt_t cy_udp_send(cy_lwip_dhcp_server_t* server, const cy_lwip_ip_address_t* address, uint16_t port, struct pbuf* p);
+static cy_rslt_t internal_udp_send(cy_lwip_dhcp_server_t* server, cy_lwip_packet_t* packet);
 static void cy_ip_to_lwip(ip_addr_t *dest, const cy_lwip_ip_address_t *src);
+#endif
 
 /******************************************************
  *               Variable Definitions
  ******************************************************/
 
-static cy_lwip_mac_addr_t             cached_mac_addresses[DHCP_IP_ADDRESS_CACHE_MAX];
-static cy_lwip_ip_address_t           cached_ip_addresses [DHCP_IP_ADDRESS_CACHE_MAX];
-static struct netif *net_interface    = NULL;
-static bool is_dhcp_server_started    = false;
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -196,36 +316,98 @@ cy_rslt_t cy_lwip_dhcp_server_start(cy_lwip_dhcp_server_t* server, cy_lwip_nw_in
 {
     cy_rslt_t result;
 
-    if(is_dhcp_server_started)
+    if(server == NULL)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error bad arguments \n");
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    /* The structure is zeroed by the caller before the first start, see cy_lwip_dhcp_server_start() in the header */
+    if(server->started)
     {
         return CY_RSLT_SUCCESS;
     }
-    
-    if((server == NULL) || (role != CY_LWIP_AP_NW_INTERFACE))
+
+    /* Serve the interface given by the caller, or the first interface added with the role */
+    if(server->netif == NULL)
+    {
+        server->netif = cy_lwip_get_interface(role);
+    }
+    if(server->netif == NULL)
     {
         wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error bad arguments \n");
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
-    if (cy_rtos_init_mutex(&dhcp_mutex) != CY_RSLT_SUCCESS)
+#if !CY_LWIP_DHCP_SERVER_RAW_API
+    if (cy_rtos_init_mutex(&server->mutex) != CY_RSLT_SUCCESS)
     {
         wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Unable to acquire DHCP mutex \n");
         return CY_RSLT_LWIP_DHCP_MUTEX_ERROR;
     }
+#endif
 
-    server->role = role;
+    server->role         = role;
+    server->lease_table  = NULL;
+    server->address_pool = NULL;
+    server->reply_pool   = NULL;
+    memset(&server->stats, 0, sizeof(server->stats));
 
+    /* Allocate the lease table, sized for the subnet of the interface */
+    if((result = lease_table_init(server, ntohl(netif_ip4_addr(server->netif)->addr), ntohl(netif_ip4_netmask(server->netif)->addr))) != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error : Unable to allocate the lease table \n");
+        goto exit;
+    }
+
+    /* Reserve the reply buffers, so that replying never waits for memory */
+    if((result = reply_pool_init(server)) != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error : Unable to allocate the reply buffers \n");
+        goto exit;
+    }
+
+    /* Prepare the options sent in the replies */
+    reply_template_init(server);
+
+#if CY_LWIP_DHCP_SERVER_RAW_API
+    /* Messages are received and replied to in the TCP/IP thread. The PCB is bound to the address of the interface,
+     * so that servers of other interfaces can bind the same port, and still receives the broadcast messages */
+    cy_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+    LOCK_TCPIP_CORE();
+    server->pcb = udp_new();
+    if((server->pcb == NULL) || (udp_bind(server->pcb, netif_ip_addr4(server->netif), IPPORT_DHCPS) != ERR_OK))
+    {
+        if(server->pcb != NULL)
+        {
+            udp_remove(server->pcb);
+            server->pcb = NULL;
+        }
+        result = CY_RSLT_LWIP_SOCKET_CREATE_FAIL;
+    }
+    else
+    {
+        udp_bind_netif(server->pcb, server->netif);
+        ip_set_option(server->pcb, SOF_BROADCAST);
+        udp_recv(server->pcb, dhcp_server_recv, server);
+        if(server->config.static_arp)
+        {
+            sys_timeout(DHCP_ARP_EXPIRY_CHECK_INTERVAL_MS, dhcp_server_arp_timer, server);
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+    if(result != CY_RSLT_SUCCESS)
+    {
+        wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error : UDP PCB creation failed \n");
+    }
+#else
     /* Create DHCP socket */
-    if((result = udp_create_socket(&server->socket, IPPORT_DHCPS, role)) != CY_RSLT_SUCCESS)
+    if((result = udp_create_socket(&server->socket, IPPORT_DHCPS, server->netif)) != CY_RSLT_SUCCESS)
     {
         wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error : UDP socket creation failed \n");
         goto exit;
     }
 
-    /* Clear cache */
-    memset(cached_mac_addresses, 0, sizeof(cached_mac_addresses));
-    memset(cached_ip_addresses,  0, sizeof(cached_ip_addresses));
-
     /* Initialize the server quit flag - done here in case quit is requested before thread runs */
     server->quit = false;
 
@@ -236,447 +418,1043 @@ cy_rslt_t cy_lwip_dhcp_server_start(cy_lwip_dhcp_server_t* server, cy_lwip_nw_in
         wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "Error : Unable to create the DHCP thread \n");
         udp_delete_socket(&server->socket);
     }
+#endif
+
+exit:
+    if(result != CY_RSLT_SUCCESS)
+    {
+        lease_table_deinit(server);
+        reply_pool_deinit(server);
+#if !CY_LWIP_DHCP_SERVER_RAW_API
+        cy_rtos_deinit_mutex(&server->mutex);
+#endif
+    }
+    else
+    {
+        server->started = true;
+    }
+
+    return result;
+}
+
+cy_rslt_t cy_lwip_dhcp_server_stop(cy_lwip_dhcp_server_t* server)
+{
+    cy_rslt_t res = CY_RSLT_SUCCESS;
+
+    if(server == NULL)
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+
+    if(!server->started)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+#if CY_LWIP_DHCP_SERVER_RAW_API
+    /* No message is handled once the PCB is removed */
+    cy_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
+    LOCK_TCPIP_CORE();
+    udp_remove(server->pcb);
+    server->pcb = NULL;
+    sys_untimeout(dhcp_server_arp_timer, server);
+    /* The static ARP entries of the leases are removed with the core locked */
+    lease_table_deinit(server);
+    UNLOCK_TCPIP_CORE();
+#else
+    /* The thread holds the core lock or the server mutex at times, so it is left to exit rather than
+     * terminated. It sees the quit flag within DHCP_SERVER_RECEIVE_TIMEOUT */
+    server->quit = true;
+    cy_rtos_join_thread(&server->thread);
+    /* Delete DHCP socket */
+    res = udp_delete_socket(&server->socket);
+    cy_rtos_deinit_mutex(&server->mutex);
+    lease_table_deinit(server);
+#endif
+    reply_pool_deinit(server);
+    server->started = false;
+    return res;
+}
+
+bool cy_lwip_dhcp_server_is_lease_arp_entry(const ip4_addr_t *ip_addr)
+{
+#if DHCP_STATIC_ARP_ENTRIES
+    uint32_t a;
+
+    for ( a = 0; a < CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX; a++ )
+    {
+        if ( ( dhcp_lease_arp_addr[ a ] != 0 ) && ( dhcp_lease_arp_addr[ a ] == ntohl( ip4_addr_get_u32( ip_addr ) ) ) )
+        {
+            return true;
+        }
+    }
+#else
+    LWIP_UNUSED_ARG( ip_addr );
+#endif /* DHCP_STATIC_ARP_ENTRIES */
+    return false;
+}
+
+/**
+ *  Builds the options which are the same in all the OFFER and ACK replies of the server
+ *
+ * @param[in] server : DHCP server instance
+ */
+static void reply_template_init(cy_lwip_dhcp_server_t* server)
+{
+    uint8_t  *option_ptr = server->reply_template;
+    uint32_t server_ip_addr_htobe;
+    uint32_t netmask_htobe;
+    uint32_t lease_time_htobe;
+    uint16_t mtu = CY_LWIP_PAYLOAD_MTU;
+
+    /* Save local IP address to be sent in DHCP packets */
+    server->local_ip_addr        = ntohl(netif_ip4_addr(server->netif)->addr);
+    server_ip_addr_htobe = htobe32(server->local_ip_addr);
+    netmask_htobe        = htobe32(ntohl(netif_ip4_netmask(server->netif)->addr));
+    lease_time_htobe     = htobe32((server->config.lease_time != 0) ? server->config.lease_time : DHCP_LEASE_TIME_S);
+
+    /* The server identifier comes first, it is the only option of the NAK replies */
+    *option_ptr++ = DHCP_SERVER_IDENTIFIER_OPTION_CODE;                                                 /* Server identifier            */
+    *option_ptr++ = 4;
+    option_ptr    = MEMCAT( option_ptr, &server_ip_addr_htobe, 4 );
+    *option_ptr++ = DHCP_LEASETIME_OPTION_CODE;                                                         /* Lease Time                   */
+    *option_ptr++ = 4;
+    option_ptr    = MEMCAT( option_ptr, &lease_time_htobe, 4 );
+    *option_ptr++ = DHCP_SUBNETMASK_OPTION_CODE;                                                        /* Subnet Mask                  */
+    *option_ptr++ = 4;
+    option_ptr    = MEMCAT( option_ptr, &netmask_htobe, 4 );
+    *option_ptr++ = DHCP_WPAD_OPTION_CODE;                                                              /* Web proxy auto discovery URL */
+    *option_ptr++ = sizeof(WPAD_SAMPLE_URL)-1;
+    memcpy( option_ptr, WPAD_SAMPLE_URL, sizeof(WPAD_SAMPLE_URL)-1 );
+    ipv4_to_string( (char*)&option_ptr[7], server_ip_addr_htobe );
+    option_ptr   += sizeof(WPAD_SAMPLE_URL)-1;
+    *option_ptr++ = DHCP_ROUTER_OPTION_CODE;                                                            /* Router (gateway)             */
+    *option_ptr++ = 4;
+    option_ptr    = MEMCAT( option_ptr, &server_ip_addr_htobe, 4 );
+    *option_ptr++ = DHCP_DNS_SERVER_OPTION_CODE;                                                        /* DNS server                   */
+    *option_ptr++ = 4;
+    option_ptr    = MEMCAT( option_ptr, &server_ip_addr_htobe, 4 );
+    *option_ptr++ = DHCP_MTU_OPTION_CODE;                                                               /* Interface MTU                */
+    *option_ptr++ = 2;
+    *option_ptr++ = (uint8_t)(mtu >> 8);
+    *option_ptr++ = (uint8_t)(mtu & 0xff);
+    *option_ptr   = DHCP_END_OPTION_CODE;                                                               /* end options                  */
+}
+
+/**
+ *  Writes a reply: the header of the request with the fields of the reply patched, the message type and the options of the template
+ *
+ * @param[in]  server              : DHCP server instance
+ * @param[in]  request_header      : Received message
+ * @param[out] reply_header        : Where to write the reply
+ * @param[in]  leading_options        : Options written before the template, starting with the DHCP message type
+ * @param[in]  leading_options_length : Length of the leading options
+ * @param[in]  your_ip_addr           : Address given to the client, host byte order. 0 for a NAK, which only carries the server identifier
+ *
+ * @return Length of the reply
+ */
+static uint16_t reply_build(const cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, dhcp_header_t* reply_header, const uint8_t* leading_options, uint8_t leading_options_length, uint32_t your_ip_addr)
+{
+    uint8_t  *option_ptr;
+    uint32_t your_ip_addr_htonl = htonl(your_ip_addr);
+
+    /* Only the options written are sent, the rest of the options area is left as is */
+    memcpy( reply_header, request_header, DHCP_HEADER_FIXED_LENGTH );
+    reply_header->opcode = BOOTP_OP_REPLY;
+    memcpy( reply_header->your_ip_addr, &your_ip_addr_htonl, 4 );
+    memcpy( reply_header->magic, dhcp_magic_cookie, 4 );
+
+    option_ptr = MEMCAT( reply_header->options, leading_options, leading_options_length );             /* DHCP message type            */
+    if ( your_ip_addr != 0 )
+    {
+        option_ptr = MEMCAT( option_ptr, server->reply_template, sizeof(server->reply_template) );
+    }
+    else
+    {
+        option_ptr    = MEMCAT( option_ptr, server->reply_template, DHCP_SERVER_IDENTIFIER_OPTION_LENGTH );    /* Server identifier            */
+        *option_ptr++ = DHCP_END_OPTION_CODE;                                                          /* end options                  */
+    }
+
+    return (uint16_t) ( option_ptr - (uint8_t*) reply_header );
+}
+
+/**
+ *  Binds a lease offered to a client, or extends the lease of the client
+ *
+ * @param[in] server : DHCP server instance
+ * @param[in] lease  : Lease of the client
+ * @param[in] now    : Server time in seconds
+ */
+static void lease_bind(const cy_lwip_dhcp_server_t* server, dhcp_lease_t* lease, uint32_t now)
+{
+    lease->state     = DHCP_LEASE_SLOT_BOUND;
+    lease->expiry    = now + ( ( server->config.lease_time != 0 ) ? server->config.lease_time : DHCP_LEASE_TIME_S );
+    lease->last_used = now;
+
+    if ( server->config.static_arp )
+    {
+        lease_arp_entry_add( lease );
+    }
+}
+
+/**
+ *  Chooses where to send a reply, as in RFC 2131 section 4.1. NAK replies, and replies to clients which ask for it with the
+ *  broadcast flag, are broadcast. Other replies are sent to the address of the client, or to the address given to the client,
+ *  which is resolved through a static ARP entry added for the time of the transmission. Must be called with the TCP/IP core locked.
+ *
+ * @param[in]  server          : DHCP server instance
+ * @param[in]  reply_header    : Reply to send
+ * @param[out] arp_entry_added : true when an ARP entry was added for the destination, to remove with reply_arp_entry_remove once the reply is sent
+ *
+ * @return Destination address, host byte order
+ */
+static uint32_t reply_destination(const cy_lwip_dhcp_server_t* server, const dhcp_header_t* reply_header, bool* arp_entry_added)
+{
+    uint32_t client_ip_addr;
+    uint32_t your_ip_addr;
+
+    *arp_entry_added = false;
+
+    memcpy( &client_ip_addr, reply_header->client_ip_addr, 4 );
+    memcpy( &your_ip_addr, reply_header->your_ip_addr, 4 );
+
+    if ( ( your_ip_addr == 0 ) || ( ( reply_header->flags & PP_HTONS( BOOTP_FLAG_BROADCAST ) ) != 0 ) )
+    {
+        return IPADDR_BROADCAST;
+    }
+
+    if ( client_ip_addr != 0 )
+    {
+        /* The client has its address configured and answers ARP requests for it */
+        return ntohl( client_ip_addr );
+    }
+
+#if DHCP_STATIC_ARP_ENTRIES
+    if ( ( reply_header->hardware_type == LWIP_IANA_HWTYPE_ETHERNET ) && ( reply_header->hardware_addr_len == ETH_HWADDR_LEN ) )
+    {
+        ip4_addr_t       arp_ip_addr;
+        struct eth_addr  arp_hw_addr;
+        struct eth_addr  *known_hw_addr;
+        const ip4_addr_t *known_ip_addr;
+
+        ip4_addr_set_u32( &arp_ip_addr, your_ip_addr );
+        memcpy( arp_hw_addr.addr, reply_header->client_hardware_addr, ETH_HWADDR_LEN );
+
+        /* Already resolved, by the static entry of the lease for instance, which must stay */
+        if ( ( etharp_find_addr( server->netif, &arp_ip_addr, &known_hw_addr, &known_ip_addr ) >= 0 ) &&
+             ( memcmp( known_hw_addr->addr, arp_hw_addr.addr, ETH_HWADDR_LEN ) == 0 ) )
+        {
+            return ntohl( your_ip_addr );
+        }
+
+        if ( etharp_add_static_entry( &arp_ip_addr, &arp_hw_addr ) == ERR_OK )
+        {
+            *arp_entry_added = true;
+            return ntohl( your_ip_addr );
+        }
+    }
+#endif /* DHCP_STATIC_ARP_ENTRIES */
+
+    return IPADDR_BROADCAST;
+}
+
+/**
+ *  Removes the ARP entry added by reply_destination once the reply is sent. Must be called with the TCP/IP core locked.
+ *
+ * @param[in] ip_addr : Destination of the reply, host byte order
+ */
+static void reply_arp_entry_remove(uint32_t ip_addr)
+{
+#if DHCP_STATIC_ARP_ENTRIES
+    ip4_addr_t arp_ip_addr;
+
+    ip4_addr_set_u32( &arp_ip_addr, htonl( ip_addr ) );
+    etharp_remove_static_entry( &arp_ip_addr );
+#else
+    LWIP_UNUSED_ARG( ip_addr );
+#endif /* DHCP_STATIC_ARP_ENTRIES */
+}
+
+/**
+ *  Implements a very simple DHCP server: handles a received message and builds the reply.
+ *
+ *  Server will offer the address leased to the client, or a free address of the pool, to a DISCOVER command
+ *  Server will ACK a DISCOVER command carrying the rapid commit option instead, when rapid commit is enabled
+ *  Server will NAK any REQUEST command which is not requesting the address leased or offered to the client
+ *  Server will ACK any REQUEST command which is for the address leased or offered to the client
+ *  When the pool or the lease table is full, the expired lease least recently used is reclaimed
+ *  Server will expire the lease of a client which RELEASEs its address, and keep an address DECLINEd by a client out of the pool for a while
+ *
+ * @param[in]  server         : DHCP server instance
+ * @param[in]  request_header : Received message
+ * @param[in]  request_length : Length of the received message
+ * @param[out] reply_header   : Buffer of DHCP_REPLY_MAX_LENGTH bytes which receives the reply
+ *
+ * @return Length of the reply, 0 if there is nothing to send
+ */
+static uint16_t dhcp_server_process(cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, uint16_t request_length, dhcp_header_t* reply_header)
+{
+    cy_lwip_mac_addr_t      client_mac_address;
+    uint32_t                requested_ip_addr;
+    dhcp_lease_t            *lease;
+    uint32_t                now;
+    uint16_t                reply_length = 0;
+    const uint8_t           *find_option_ptr;
+
+    /* Check if received data length is at least the size of  dhcp_header_t. */
+    /* Options field in DHCP header is variable length. We are looking for option "DHCP Message Type" that is 3 octets in size (code, length and type) */
+    if (request_length < (sizeof(dhcp_header_t) - sizeof(request_header->options) + 3))
+    {
+        server->stats.dropped++;
+        return 0;
+    }
+
+    /* Check if the option in the dhcp header is "DHCP Message Type", code value for option "DHCP Message Type" is 53 as per rfc2132 */
+    if (request_header->options[0] != DHCP_MESSAGETYPE_OPTION_CODE)
+    {
+        server->stats.dropped++;
+        return 0;
+    }
+
+    /* Record client MAC address */
+    memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
+    now = server_time(server);
+
+    /* Check DHCP command */
+    switch (request_header->options[2])
+    {
+        case DHCPDISCOVER:
+        {
+            server->stats.discover++;
+
+            /* Offer the address leased to the client, or reserve a free one */
+            lease = lease_allocate( server, &client_mac_address, 0, now );
+            if (lease == NULL)
+            {
+                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "No address left in the DHCP pool \n");
+                server->stats.pool_exhausted++;
+                return 0;
+            }
+
+            if ( server->config.rapid_commit && ( find_option( request_header, DHCP_RAPID_COMMIT_OPTION_CODE ) != NULL ) )
+            {
+                /* The client accepts a two message exchange - bind the lease and ACK right away (RFC 4039) */
+                reply_length = reply_build( server, request_header, reply_header, dhcp_ack_rapid_commit_option_buff, sizeof(dhcp_ack_rapid_commit_option_buff), lease->ip_addr );
+                lease_bind( server, lease, now );
+                server->stats.ack++;
+                break;
+            }
+
+            reply_length = reply_build( server, request_header, reply_header, dhcp_offer_option_buff, sizeof(dhcp_offer_option_buff), lease->ip_addr );
+            server->stats.offer++;
+        }
+        break;
+
+        case DHCPREQUEST:
+        {
+            /* REQUEST command - send back ACK or NAK */
+            server->stats.request++;
+
+            /* Check that the REQUEST is for this server */
+            find_option_ptr = find_option( request_header, DHCP_SERVER_IDENTIFIER_OPTION_CODE );
+            if ( ( find_option_ptr != NULL ) && ( server->local_ip_addr != htobe32( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) ) ) )
+            {
+                server->stats.dropped++;
+                return 0; /* Server ID does not match local IP address */
+            }
+
+            /* Locate the requested address in the options, a renewing client sends it as its own address instead */
+            find_option_ptr = find_option( request_header, DHCP_REQUESTED_IP_ADDRESS_OPTION_CODE );
+            if( find_option_ptr == NULL )
+            {
+                find_option_ptr = request_header->client_ip_addr;
+            }
+            requested_ip_addr = ntohl( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) );
+
+            /* Give the address leased or offered to the client. A client unknown to the server gets the address it requests if it is free */
+            lease = lease_find( server, &client_mac_address );
+            if ( lease == NULL )
+            {
+                lease = lease_allocate( server, &client_mac_address, requested_ip_addr, now );
+            }
+
+            /* Check if the requested IP address matches one we have assigned */
+            if ( ( lease == NULL ) || ( lease->ip_addr != requested_ip_addr ) )
+            {
+                /* Request is not for the assigned IP - force client to take next available IP by sending NAK */
+                reply_length = reply_build( server, request_header, reply_header, dhcp_nak_option_buff, sizeof(dhcp_nak_option_buff), 0 );
+                server->stats.nak++;
+            }
+            else
+            {
+                /* Request is for next available IP */
+                reply_length = reply_build( server, request_header, reply_header, dhcp_ack_option_buff, sizeof(dhcp_ack_option_buff), lease->ip_addr );
+                lease_bind( server, lease, now );
+                server->stats.ack++;
+            }
+        }
+        break;
+
+        case DHCPRELEASE:
+        case DHCPDECLINE:
+        {
+            /* The client gives its address back, or found it in use by another host - no reply */
+            uint8_t command = request_header->options[2];
+
+            if ( command == DHCPRELEASE )
+            {
+                server->stats.release++;
+            }
+            else
+            {
+                server->stats.decline++;
+            }
+
+            find_option_ptr = find_option( request_header, DHCP_SERVER_IDENTIFIER_OPTION_CODE );
+            if ( ( find_option_ptr == NULL ) || ( server->local_ip_addr != htobe32( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) ) ) )
+            {
+                server->stats.dropped++;
+                return 0; /* Not for this server */
+            }
+
+            /* A RELEASE carries the address as the client address, a DECLINE in the requested address option */
+            find_option_ptr = ( command == DHCPDECLINE ) ? find_option( request_header, DHCP_REQUESTED_IP_ADDRESS_OPTION_CODE ) : request_header->client_ip_addr;
+            if ( find_option_ptr == NULL )
+            {
+                server->stats.dropped++;
+                return 0;
+            }
+            requested_ip_addr = ntohl( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) );
+
+            lease = lease_find( server, &client_mac_address );
+            if ( ( lease == NULL ) || ( lease->ip_addr != requested_ip_addr ) )
+            {
+                server->stats.dropped++;
+                return 0;
+            }
+
+            if ( command == DHCPRELEASE )
+            {
+                /* Expire the lease: the address goes back to the client if it comes back before the address is reclaimed */
+                lease->expiry    = now;
+                lease->last_used = now;
+                lease_arp_entry_remove( lease );
+            }
+            else
+            {
+                /* The client will DISCOVER again and get another address */
+                wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_ERR, "DHCP client declined an address in use \n");
+                lease_remove( server, lease );
+                quarantine_add( server, requested_ip_addr, now );
+            }
+        }
+        return 0;
+
+        default:
+            /* Unknown packet type */
+            server->stats.dropped++;
+        return 0;
+    }
+
+    return reply_length;
+}
+
+#if CY_LWIP_DHCP_SERVER_RAW_API
+/**
+ *  Receives the messages sent to the DHCP server and replies in place. Runs in the TCP/IP thread.
+ */
+static void dhcp_server_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    cy_lwip_dhcp_server_t       *server = (cy_lwip_dhcp_server_t*)arg;
+    struct pbuf                 *reply;
+    uint32_t                    destination_ip_addr;
+    bool                        arp_entry_added;
+    ip_addr_t                   destination;
+
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    if (p->len != p->tot_len)
+    {
+        /* We don't support fragmented packets */
+        pbuf_free(p);
+        return;
+    }
+
+    reply = dhcp_server_handle(server, (const dhcp_header_t*)p->payload, p->len);
+    pbuf_free(p);
+
+    if (reply != NULL)
+    {
+        destination_ip_addr = reply_destination(server, (const dhcp_header_t*)reply->payload, &arp_entry_added);
+        ip_addr_set_ip4_u32(&destination, htonl(destination_ip_addr));
+        udp_sendto_if(pcb, reply, &destination, IPPORT_DHCPC, server->netif);
+        if (arp_entry_added)
+        {
+            reply_arp_entry_remove(destination_ip_addr);
+        }
+        pbuf_free(reply);
+    }
+}
+
+/**
+ *  Removes the static ARP entries of the leases which expired, and rearms itself. Runs in the TCP/IP thread.
+ */
+static void dhcp_server_arp_timer(void *arg)
+{
+    cy_lwip_dhcp_server_t *server = (cy_lwip_dhcp_server_t*)arg;
+
+    lease_arp_entries_expire(server, server_time(server));
+    sys_timeout(DHCP_ARP_EXPIRY_CHECK_INTERVAL_MS, dhcp_server_arp_timer, arg);
+}
+#else
+/**
+ *  Runs the DHCP server: waits for the messages and sends the replies
+ *
+ * @param thread_input : DHCP server instance
+ */
+static void cy_dhcp_thread_func(cy_thread_arg_t thread_input)
+{
+    cy_lwip_packet_t             *received_packet;
+    struct pbuf                  *reply;
+    cy_lwip_dhcp_server_t        *server          = (cy_lwip_dhcp_server_t*)thread_input;
+    cy_lwip_ip_address_t         destination;
+    uint32_t                     arp_check_time = sys_now();
+
+    /* Loop endlessly */
+    while ( server->quit == false )
+    {
+        uint16_t       data_length = 0;
+        uint16_t       available_data_length = 0;
+        uint32_t       destination_ip_addr;
+        bool           arp_entry_added;
+        dhcp_header_t  *request_header;
+
+        /* The receive timeout is shorter than the ARP check interval, which is kept so that the core is not locked more often */
+        if (server->config.static_arp && ((uint32_t)(sys_now() - arp_check_time) >= DHCP_ARP_EXPIRY_CHECK_INTERVAL_MS))
+        {
+            arp_check_time = sys_now();
+            lease_arp_entries_expire(server, server_time(server));
+        }
+
+        /* Sleep until data is received from socket, or until the quit flag is checked again */
+        if (udp_receive(&server->socket, &received_packet, DHCP_SERVER_RECEIVE_TIMEOUT) != CY_RSLT_SUCCESS)
+        {
+            continue;
+        }
+
+        /* Get a pointer to the data in the packet */
+        packet_get_data(received_packet, 0, (uint8_t**) &request_header, &data_length, &available_data_length);
+
+        if (data_length != available_data_length)
+        {
+            /* We don't support fragmented packets */
+            packet_delete(received_packet);
+            continue;
+        }
+
+        reply = dhcp_server_handle(server, request_header, data_length);
+
+        /* Finished with the received packet - release it */
+        packet_delete(received_packet);
+
+        if (reply == NULL)
+        {
+            continue;
+        }
+
+        LOCK_TCPIP_CORE();
+        destination_ip_addr = reply_destination(server, (const dhcp_header_t*) reply->payload, &arp_entry_added);
+        UNLOCK_TCPIP_CORE();
+        SET_IPV4_ADDRESS(destination, destination_ip_addr);
+
+        /* Send reply packet */
+        cy_udp_send(server, &destination, IPPORT_DHCPC, reply);
+        pbuf_free(reply);
+
+        if (arp_entry_added)
+        {
+            LOCK_TCPIP_CORE();
+            reply_arp_entry_remove(destination_ip_addr);
+            UNLOCK_TCPIP_CORE();
+        }
+    }
+    cy_rtos_exit_thread();
+}
+#endif /* CY_LWIP_DHCP_SERVER_RAW_API */
+
+/**
+ *  Finds a specified DHCP option
+ *
+ *  Searches the given DHCP request and returns a pointer to the
+ *  specified DHCP option data, or NULL if not found
+ *
+ * @param[out] request    : The DHCP request structure
+ * @param[in]  option_num : Which DHCP option number to find
+ *
+ * @return Pointer to the DHCP option data, or NULL if not found
+ */
+static const uint8_t* find_option( const dhcp_header_t* request, uint8_t option_num )
+{
+    const uint8_t* option_ptr = request->options;
+    while ( ( option_ptr[0] != DHCP_END_OPTION_CODE ) &&                               /* Check for end-of-options flag */
+            ( option_ptr[0] != option_num ) &&                                         /* Check for matching option number */
+            ( option_ptr < ( (const uint8_t*) request ) + sizeof( dhcp_header_t ) ) )  /* Check for buffer overrun */
+    {
+        option_ptr += option_ptr[1] + 2;
+    }
+
+    /* Was the option found? */
+    if ( option_ptr[0] == option_num )
+    {
+        return &option_ptr[2];
+    }
+    return NULL;
+}
+
+/**
+ *  Allocates the lease table and the address pool bitmap for a subnet
+ *
+ *  The pool holds the host numbers of the subnet, up to DHCP_ADDRESS_POOL_MAX of them, minus the
+ *  address of the server. The lease table has at least twice as many slots as leases, so that
+ *  lookups seldom probe more than one or two slots.
+ *
+ * @param[in] server         : DHCP server instance
+ * @param[in] server_ip_addr : IP address of the server, host byte order
+ * @param[in] netmask        : Netmask of the subnet, host byte order
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise
+ */
+static cy_rslt_t lease_table_init( cy_lwip_dhcp_server_t* server, uint32_t server_ip_addr, uint32_t netmask )
+{
+    uint32_t slots = 1;
+    uint32_t local_host = server_ip_addr & ~netmask;
+
+    server->pool_subnet = server_ip_addr & netmask;
+    server->pool_size   = MIN( ( ~netmask ) - 1, DHCP_ADDRESS_POOL_MAX );
+    if ( ( ~netmask < 2 ) || ( server->pool_size == 0 ) )
+    {
+        return CY_RSLT_LWIP_BAD_ARG;
+    }
+    server->lease_max = MIN( ( server->config.max_leases != 0 ) ? server->config.max_leases : CY_LWIP_DHCP_SERVER_MAX_LEASES, server->pool_size );
+    while ( slots < ( server->lease_max * 2 ) )
+    {
+        slots <<= 1;
+    }
+
+    server->lease_table      = (dhcp_lease_t*) calloc( slots, sizeof( dhcp_lease_t ) );
+    server->lease_table_mask = slots - 1;
+    server->lease_count      = 0;
+    server->address_pool     = (uint32_t*) calloc( ( server->pool_size >> 5 ) + 1, sizeof( uint32_t ) );
+    if ( ( server->lease_table == NULL ) || ( server->address_pool == NULL ) )
+    {
+        lease_table_deinit(server);
+        return CY_RSLT_LWIP_DHCP_SERVER_NO_MEMORY;
+    }
+
+    /* The address of the server is never leased. Hand out addresses from the one following it, as before */
+    if ( local_host <= server->pool_size )
+    {
+        POOL_BIT_SET( server->address_pool, local_host );
+    }
+    server->pool_next_host = ( local_host < server->pool_size ) ? ( local_host + 1 ) : 1;
+
+    memset( server->quarantine_addr, 0, sizeof( server->quarantine_addr ) );
+    server->quarantine_next = 0;
+
+    cy_rtos_get_time( &server->server_time_ms );
+    server->server_time_s      = 0;
+    server->server_time_rem_ms = 0;
+
+    return CY_RSLT_SUCCESS;
+}
+
+/**
+ *  Frees the lease table and the address pool bitmap
+ *
+ * @param[in] server : DHCP server instance
+ */
+static void lease_table_deinit( cy_lwip_dhcp_server_t* server )
+{
+    uint32_t a;
+
+    if ( server->lease_table != NULL )
+    {
+        for ( a = 0; a <= server->lease_table_mask; a++ )
+        {
+            lease_arp_entry_remove( &server->lease_table[ a ] );
+        }
+    }
+
+    free( server->lease_table );
+    free( server->address_pool );
+    server->lease_table  = NULL;
+    server->address_pool = NULL;
+    server->lease_count  = 0;
+}
+
+/**
+ *  Returns the time elapsed since the server started, in seconds. Unlike the RTOS time in
+ *  milliseconds, it does not wrap around within the life of a lease.
+ *
+ * @param[in] server : DHCP server instance
+ */
+static uint32_t server_time( cy_lwip_dhcp_server_t* server )
+{
+    cy_time_t now_ms;
+
+    cy_rtos_get_time( &now_ms );
+    server->server_time_rem_ms += (uint32_t) ( now_ms - server->server_time_ms );
+    server->server_time_ms      = now_ms;
+    server->server_time_s      += server->server_time_rem_ms / 1000;
+    server->server_time_rem_ms %= 1000;
+
+    return server->server_time_s;
+}
+
+/**
+ *  Searches the lease table for a given MAC address
+ *
+ * @param[in]  server             : DHCP server instance
+ * @param[in]  client_mac_address : MAC address to search for
+ *
+ * @return the lease of the client, or NULL if none
+ */
+static dhcp_lease_t* lease_find( const cy_lwip_dhcp_server_t* server, const cy_lwip_mac_addr_t* client_mac_address )
+{
+    uint32_t slot = DHCP_LEASE_HASH( client_mac_address ) & server->lease_table_mask;
+
+    /* Leases are removed by backward shifting, an empty slot ends the probe sequence */
+    while ( server->lease_table[ slot ].state != DHCP_LEASE_SLOT_EMPTY )
+    {
+        if ( memcmp( &server->lease_table[ slot ].mac, client_mac_address, sizeof( *client_mac_address ) ) == 0 )
+        {
+            return &server->lease_table[ slot ];
+        }
+        slot = ( slot + 1 ) & server->lease_table_mask;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Removes a lease and returns its address to the pool
+ *
+ *  The leases following it in the probe sequence are shifted back into the hole, so that no
+ *  deleted markers accumulate as clients come and go. Pointers to leases are invalidated.
+ *
+ * @param[in] server : DHCP server instance
+ * @param[in] lease  : Lease to remove
+ */
+static void lease_remove( cy_lwip_dhcp_server_t* server, dhcp_lease_t* lease )
+{
+    uint32_t hole = (uint32_t) ( lease - server->lease_table );
+    uint32_t slot = hole;
 
-exit:
-    if(result != CY_RSLT_SUCCESS)
-    {
-        cy_rtos_deinit_mutex(&dhcp_mutex);
-    }
-    else
+    lease_arp_entry_remove( lease );
+    POOL_BIT_CLEAR( server->address_pool, lease->ip_addr - server->pool_subnet );
+    server->lease_count--;
+
+    for ( ;; )
     {
-        is_dhcp_server_started = true;
+        uint32_t home;
+
+        slot = ( slot + 1 ) & server->lease_table_mask;
+        if ( server->lease_table[ slot ].state == DHCP_LEASE_SLOT_EMPTY )
+        {
+            break;
+        }
+
+        /* Move the lease into the hole unless its home slot lies cyclically between the hole and the lease */
+        home = DHCP_LEASE_HASH( &server->lease_table[ slot ].mac ) & server->lease_table_mask;
+        if ( ( ( slot - home ) & server->lease_table_mask ) >= ( ( slot - hole ) & server->lease_table_mask ) )
+        {
+            server->lease_table[ hole ] = server->lease_table[ slot ];
+            hole = slot;
+        }
     }
 
-    return result;
+    memset( &server->lease_table[ hole ], 0, sizeof( dhcp_lease_t ) );
 }
 
-cy_rslt_t cy_lwip_dhcp_server_stop(cy_lwip_dhcp_server_t* server)
+/**
+ *  Reclaims the expired lease, or expired offer, which was least recently used
+ *
+ * @param[in] server : DHCP server instance
+ * @param[in] now    : Current server time
+ *
+ * @return true if a lease was reclaimed, false if no lease is expired
+ */
+static bool lease_evict_expired( cy_lwip_dhcp_server_t* server, uint32_t now )
 {
-    cy_rslt_t res = CY_RSLT_SUCCESS;
+    dhcp_lease_t *oldest = NULL;
+    uint32_t a;
 
-    if(!is_dhcp_server_started)
+    for ( a = 0; a <= server->lease_table_mask; a++ )
     {
-        return CY_RSLT_SUCCESS;
+        dhcp_lease_t *lease = &server->lease_table[ a ];
+
+        if ( ( lease->state != DHCP_LEASE_SLOT_EMPTY ) && DHCP_LEASE_EXPIRED( lease, now ) &&
+             ( ( oldest == NULL ) || ( (int32_t) ( lease->last_used - oldest->last_used ) < 0 ) ) )
+        {
+            oldest = lease;
+        }
     }
 
-    if(server == NULL)
+    if ( oldest == NULL )
     {
-        return CY_RSLT_LWIP_BAD_ARG;
+        return false;
     }
-
-    server->quit = true;
-    cy_rtos_terminate_thread(&server->thread);
-    cy_rtos_join_thread(&server->thread);
-    /* Delete DHCP socket */
-    res = udp_delete_socket(&server->socket);
-    cy_rtos_deinit_mutex(&dhcp_mutex);
-    is_dhcp_server_started = false;
-    return res;
+    lease_remove( server, oldest );
+    return true;
 }
 
 /**
- *  Implements a very simple DHCP server.
+ *  Returns the next free host number of the pool, round robin so that an address just given
+ *  back is not reused right away
  *
- *  Server will always offer next available address to a DISCOVER command
- *  Server will NAK any REQUEST command which is not requesting the next available address
- *  Server will ACK any REQUEST command which is for the next available address, and then increment the next available address
+ * @param[in] server : DHCP server instance
  *
- * @param my_addr : local IP address for binding of server port.
+ * @return the host number, 0 if the pool is full
  */
-static void cy_dhcp_thread_func(cy_thread_arg_t thread_input)
+static uint32_t pool_find_free( cy_lwip_dhcp_server_t* server )
 {
-    cy_lwip_packet_t             *received_packet;
-    cy_lwip_packet_t             *transmit_packet = NULL;
-    cy_lwip_ip_address_t         local_ip_address;
-    cy_lwip_ip_address_t         netmask;
-    uint32_t                     next_available_ip_addr;
-    uint32_t                     ip_mask;
-    uint32_t                     subnet;
-    uint32_t                     netmask_htobe;
-    char                         *option_ptr;
-    cy_lwip_dhcp_server_t        *server                      = (cy_lwip_dhcp_server_t*)thread_input;
-    uint8_t                      subnet_mask_option_buff[]    = { DHCP_SUBNETMASK_OPTION_CODE, 4, 0, 0, 0, 0 };
-    uint8_t                      server_ip_addr_option_buff[] = { DHCP_SERVER_IDENTIFIER_OPTION_CODE, 4, 0, 0, 0, 0 };
-    uint32_t                     *server_ip_addr_ptr          = (uint32_t*)&server_ip_addr_option_buff[2];
-    uint8_t                      wpad_option_buff[ 2 + sizeof(WPAD_SAMPLE_URL)-1 ] = { DHCP_WPAD_OPTION_CODE, sizeof(WPAD_SAMPLE_URL)-1 };
-    cy_lwip_ip_address_t         broadcast_addr;
-
-    SET_IPV4_ADDRESS(broadcast_addr, MAKE_IPV4_ADDRESS(255, 255, 255, 255));
-    /* Save local IP address to be sent in DHCP packets */
-    net_interface = cy_lwip_get_interface(server->role);
-    local_ip_address.version = CY_LWIP_IP_VER_V4;
-#if LWIP_IPV6
-    local_ip_address.ip.v4 = ntohl(net_interface->ip_addr.u_addr.ip4.addr);
-#else
-    local_ip_address.ip.v4 = ntohl(net_interface->ip_addr.addr);
-#endif
+    uint32_t host = server->pool_next_host;
+    uint32_t a;
 
-    *server_ip_addr_ptr = htobe32(GET_IPV4_ADDRESS(local_ip_address));
-    /* Save the current netmask to be sent in DHCP packets as the 'subnet mask option' */
-    netmask.version = CY_LWIP_IP_VER_V4;
-#if LWIP_IPV4 && LWIP_IPV6
-    netmask.ip.v4 = ntohl(net_interface->netmask.u_addr.ip4.addr);
-#elif LWIP_IPV4
-    netmask.ip.v4 = ntohl(net_interface->netmask.addr);
-#endif
-    netmask_htobe = htobe32(GET_IPV4_ADDRESS(netmask));
-    memcpy(&subnet_mask_option_buff[2], &netmask_htobe, 4);
+    for ( a = 0; a < server->pool_size; a++ )
+    {
+        if ( !POOL_BIT_TEST( server->address_pool, host ) )
+        {
+            server->pool_next_host = ( host < server->pool_size ) ? ( host + 1 ) : 1;
+            return host;
+        }
+        host = ( host < server->pool_size ) ? ( host + 1 ) : 1;
+    }
 
-    /* Calculate the first available IP address which will be served - based on the netmask and the local IP */
-    ip_mask = ~(GET_IPV4_ADDRESS(netmask));
-    subnet = GET_IPV4_ADDRESS(local_ip_address) & GET_IPV4_ADDRESS(netmask);
-    next_available_ip_addr = subnet | ((GET_IPV4_ADDRESS(local_ip_address) + 1) & ip_mask);
+    return 0;
+}
 
-    /* Prepare the Web proxy auto discovery URL */
-    memcpy(&wpad_option_buff[2], WPAD_SAMPLE_URL, sizeof(WPAD_SAMPLE_URL)-1);
-    ipv4_to_string( (char*)&wpad_option_buff[2 + 7], *server_ip_addr_ptr);
+/**
+ *  Returns the lease of a client, or leases it an address of the pool
+ *
+ *  A new lease is created in the offered state and is reclaimed if the client does not
+ *  request it within DHCP_OFFER_HOLD_TIME_S. If the pool or the lease table is full, the
+ *  expired lease least recently used is reclaimed; leases which did not expire are never taken.
+ *
+ * @param[in] server             : DHCP server instance
+ * @param[in] client_mac_address : MAC address of the client
+ * @param[in] requested_ip_addr  : Address to lease, host byte order, or 0 for any free address
+ * @param[in] now                : Current server time
+ *
+ * @return the lease, or NULL if the requested address is not available or the pool is exhausted
+ */
+static dhcp_lease_t* lease_allocate( cy_lwip_dhcp_server_t* server, const cy_lwip_mac_addr_t* client_mac_address, uint32_t requested_ip_addr, uint32_t now )
+{
+    dhcp_lease_t *lease = lease_find( server, client_mac_address );
+    uint32_t host;
+    uint32_t slot;
 
-    /* Loop endlessly */
-    while ( server->quit == false )
+    if ( lease != NULL )
     {
-        uint16_t       data_length = 0;
-        uint16_t       available_data_length = 0;
-        dhcp_header_t  *request_header;
-
-        /* Sleep until data is received from socket. */
-        if (udp_receive(&server->socket, &received_packet, WAIT_FOREVER) != CY_RSLT_SUCCESS)
+        lease->last_used = now;
+        if ( DHCP_LEASE_EXPIRED( lease, now ) )
         {
-            continue;
+            /* Released or expired, but not reclaimed yet: the client gets its address back */
+            lease->state = DHCP_LEASE_SLOT_OFFERED;
+        }
+        if ( lease->state == DHCP_LEASE_SLOT_OFFERED )
+        {
+            lease->expiry = now + DHCP_OFFER_HOLD_TIME_S;
         }
+        return lease;
+    }
 
-        /* Get a pointer to the data in the packet */
-        packet_get_data(received_packet, 0, (uint8_t**) &request_header, &data_length, &available_data_length);
+    quarantine_expire( server, now );
+    if ( ( server->lease_count >= server->lease_max ) && !lease_evict_expired( server, now ) )
+    {
+        return NULL;
+    }
 
-        if (data_length != available_data_length)
+    if ( requested_ip_addr != 0 )
+    {
+        host = requested_ip_addr - server->pool_subnet;
+        /* An address outside the subnet gives a host number out of range too */
+        if ( ( host == 0 ) || ( host > server->pool_size ) || POOL_BIT_TEST( server->address_pool, host ) )
         {
-            /* We don't support fragmented packets */
-            packet_delete(received_packet);
-            continue;
+            return NULL;
         }
-
-        /* Check if received data length is at least the size of  dhcp_header_t. */
-        /* Options field in DHCP header is variable length. We are looking for option "DHCP Message Type" that is 3 octets in size (code, length and type) */
-        if (data_length < (sizeof(dhcp_header_t) - sizeof(request_header->options) + 3))
+    }
+    else
+    {
+        host = pool_find_free( server );
+        if ( ( host == 0 ) && lease_evict_expired( server, now ) )
         {
-            packet_delete(received_packet);
-            continue;
+            host = pool_find_free( server );
         }
-
-        /* Check if the option in the dhcp header is "DHCP Message Type", code value for option "DHCP Message Type" is 53 as per rfc2132 */
-        if (request_header->options[0] != DHCP_MESSAGETYPE_OPTION_CODE)
+        if ( host == 0 )
         {
-            packet_delete(received_packet);
-            continue;
+            return NULL;
         }
+    }
 
-        /* Check DHCP command */
-        switch (request_header->options[2])
-        {
-            case DHCPDISCOVER:
-            {
-                dhcp_header_t           *reply_header   = NULL;
-                uint16_t                available_space = 0;
-                cy_lwip_mac_addr_t      client_mac_address;
-                cy_lwip_ip_address_t    client_ip_address;
-                uint32_t                temp;
-
-                /* Create reply packet */
-                if (packet_create_udp(&transmit_packet, (uint8_t**) &reply_header, &available_space) != CY_RSLT_SUCCESS)
-                {
-                    /* Cannot reply - release incoming packet */
-                    packet_delete( received_packet );
-                    break;
-                }
-
-                /* Copy in the DHCP header content from the received discover packet into the reply packet */
-                memcpy(reply_header, request_header, sizeof(dhcp_header_t) - sizeof(reply_header->options));
-
-                /* Finished with the received discover packet - release it */
-                packet_delete(received_packet);
-
-                /* Now construct the OFFER response */
-                reply_header->opcode = BOOTP_OP_REPLY;
-
-                /* Clear the DHCP options list */
-                memset( &reply_header->options, 0, sizeof( reply_header->options ) );
-
-                /* Record client MAC address */
-                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
-
-                /* Check whether device is already cached */
-                if (!get_client_ip_address_from_cache( &client_mac_address, &client_ip_address ))
-                {
-                    /* Address not found in cache. Use next available IP address */
-                    client_ip_address.version = CY_LWIP_IP_VER_V4;
-                    client_ip_address.ip.v4   = next_available_ip_addr;
-                }
-
-                /* Create the IP address for the Offer */
-                temp = htonl(client_ip_address.ip.v4);
-                memcpy(reply_header->your_ip_addr, &temp, sizeof(temp));
-
-                /* Copy the magic DHCP number */
-                memcpy(reply_header->magic, dhcp_magic_cookie, 4);
-
-                /* Add options */
-                option_ptr     = (char *) &reply_header->options;
-                option_ptr     = MEMCAT( option_ptr, dhcp_offer_option_buff, 3 );                                   /* DHCP message type            */
-                option_ptr     = MEMCAT( option_ptr, server_ip_addr_option_buff, 6 );                               /* Server identifier            */
-                option_ptr     = MEMCAT( option_ptr, lease_time_option_buff, 6 );                                   /* Lease Time                   */
-                option_ptr     = MEMCAT( option_ptr, subnet_mask_option_buff, 6 );                                  /* Subnet Mask                  */
-                option_ptr     = (char*)MEMCAT( option_ptr, wpad_option_buff, sizeof(wpad_option_buff) );           /* Web proxy auto discovery URL */
-                /* Copy the local IP into the Router & DNS server Options */
-                memcpy( option_ptr, server_ip_addr_option_buff, 6 );                                                /* Router (gateway)             */
-                option_ptr[0]  = 3;                                                                                 /* Router id                    */
-                option_ptr    += 6;
-                memcpy( option_ptr, server_ip_addr_option_buff, 6 );                                                /* DNS server                   */
-                option_ptr[0]  = 6;                                                                                 /* DNS server id                */
-                option_ptr    += 6;
-                option_ptr     = MEMCAT( option_ptr, mtu_option_buff, 4 );                                          /* Interface MTU                */
-                option_ptr[0]  = (char) DHCP_END_OPTION_CODE;                                                       /* end options                  */
-                option_ptr++;
-
-                /* Send OFFER reply packet */
-                packet_set_data_end(transmit_packet, (uint8_t*) option_ptr);
-                if (cy_udp_send(&server->socket, &broadcast_addr, IPPORT_DHCPC, transmit_packet) != CY_RSLT_SUCCESS)
-                {
-                    packet_delete(transmit_packet);
-                }
-            }
-            break;
+    slot = DHCP_LEASE_HASH( client_mac_address ) & server->lease_table_mask;
+    while ( server->lease_table[ slot ].state != DHCP_LEASE_SLOT_EMPTY )
+    {
+        slot = ( slot + 1 ) & server->lease_table_mask;
+    }
+
+    POOL_BIT_SET( server->address_pool, host );
+    server->lease_count++;
+
+    lease            = &server->lease_table[ slot ];
+    lease->mac       = *client_mac_address;
+    lease->ip_addr   = server->pool_subnet | host;
+    lease->expiry    = now + DHCP_OFFER_HOLD_TIME_S;
+    lease->last_used = now;
+    lease->state     = DHCP_LEASE_SLOT_OFFERED;
+
+    return lease;
+}
+
+/**
+ *  Adds a static ARP entry for the address leased to a client, so that the first packets sent to the
+ *  client are not held by an ARP request
+ *
+ * @param[in] lease : Bound lease
+ */
+static void lease_arp_entry_add( dhcp_lease_t* lease )
+{
+#if DHCP_STATIC_ARP_ENTRIES
+    ip4_addr_t      arp_ip_addr;
+    struct eth_addr arp_hw_addr;
+    uint32_t        a;
+
+    if ( lease->arp_entry )
+    {
+        return;
+    }
 
-            case DHCPREQUEST:
+    ip4_addr_set_u32( &arp_ip_addr, htonl( lease->ip_addr ) );
+    memcpy( arp_hw_addr.addr, lease->mac.octet, ETH_HWADDR_LEN );
+
+    DHCP_SERVER_LOCK_CORE();
+    /* Beyond the limit, the client is resolved by ARP as usual */
+    for ( a = 0; a < CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX; a++ )
+    {
+        if ( dhcp_lease_arp_addr[ a ] == 0 )
+        {
+            lease->arp_entry = ( etharp_add_static_entry( &arp_ip_addr, &arp_hw_addr ) == ERR_OK );
+            if ( lease->arp_entry )
             {
-                /* REQUEST command - send back ACK or NAK */
-                uint32_t                temp;
-                dhcp_header_t           *reply_header;
-                uint16_t                available_space;
-                cy_lwip_mac_addr_t      client_mac_address;
-                cy_lwip_ip_address_t    given_ip_address;
-                cy_lwip_ip_address_t    requested_ip_address;
-                bool                    next_avail_ip_address_used = false;
-                const uint8_t           *find_option_ptr;
-
-                /* Check that the REQUEST is for this server */
-                find_option_ptr = find_option( request_header, DHCP_SERVER_IDENTIFIER_OPTION_CODE );
-                if ( ( find_option_ptr != NULL ) && ( GET_IPV4_ADDRESS( local_ip_address ) != htobe32( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) ) ) )
-                {
-                    break; /* Server ID does not match local IP address */
-                }
-
-                /* Create reply packet */
-                if ( packet_create_udp(&transmit_packet, (uint8_t**) &reply_header, &available_space ) != CY_RSLT_SUCCESS )
-                {
-                    /* Cannot reply - release incoming packet */
-                    packet_delete( received_packet );
-                    break;
-                }
-
-                /* Copy in the DHCP header content from the received request packet into the reply packet */
-                memcpy( reply_header, request_header, sizeof(dhcp_header_t) - sizeof(reply_header->options) );
-
-                /* Record client MAC address */
-                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
-
-                /* Locate the requested address in the options and keep requested address */
-                requested_ip_address.version = CY_LWIP_IP_VER_V4;
-                find_option_ptr = find_option( request_header, DHCP_REQUESTED_IP_ADDRESS_OPTION_CODE );
-                if( find_option_ptr != NULL )
-                {
-                    requested_ip_address.ip.v4   = ntohl( LWIP_MAKEU32( find_option_ptr[3], find_option_ptr[2], find_option_ptr[1], find_option_ptr[0] ) );
-                }
-
-                /* Delete received packet. We don't need it anymore */
-                packet_delete( received_packet );
-
-                reply_header->opcode = BOOTP_OP_REPLY;
-
-                /* Blank options list */
-                memset( &reply_header->options, 0, sizeof( reply_header->options ) );
-
-                /* Copy DHCP magic number into packet */
-                memcpy( reply_header->magic, dhcp_magic_cookie, 4 );
-
-                option_ptr = (char *) &reply_header->options;
-
-                /* Check if device is cache. If it is, give the previous IP address. Otherwise give the next available IP address */
-                if ( !get_client_ip_address_from_cache( &client_mac_address, &given_ip_address ) )
-                {
-                    /* Address not found in cache. Use next available IP address */
-                    next_avail_ip_address_used = true;
-                    given_ip_address.version   = CY_LWIP_IP_VER_V4;
-                    given_ip_address.ip.v4     = next_available_ip_addr;
-                }
-
-                /* Check if the requested IP address matches one we have assigned */
-                if ( memcmp( &requested_ip_address.ip.v4, &given_ip_address.ip.v4, sizeof( requested_ip_address.ip.v4 ) ) != 0 )
-                {
-                    /* Request is not for the assigned IP - force client to take next available IP by sending NAK */
-                    /* Add appropriate options */
-                    option_ptr = (char*)MEMCAT( option_ptr, dhcp_nak_option_buff, 3 );             /* DHCP message type */
-                    option_ptr = (char*)MEMCAT( option_ptr, server_ip_addr_option_buff, 6 );       /* Server identifier */
-                    memset( reply_header->your_ip_addr, 0, sizeof( reply_header->your_ip_addr ) ); /* Clear IP addr     */
-                }
-                else
-                {
-                    /* Request is for next available IP */
-                    /* Add appropriate options */
-                    option_ptr     = (char*)MEMCAT( option_ptr, dhcp_ack_option_buff, 3 );                              /* DHCP message type            */
-                    option_ptr     = (char*)MEMCAT( option_ptr, server_ip_addr_option_buff, 6 );                        /* Server identifier            */
-                    option_ptr     = (char*)MEMCAT( option_ptr, lease_time_option_buff, 6 );                            /* Lease Time                   */
-                    option_ptr     = (char*)MEMCAT( option_ptr, subnet_mask_option_buff, 6 );                           /* Subnet Mask                  */
-                    option_ptr     = (char*)MEMCAT( option_ptr, wpad_option_buff, sizeof(wpad_option_buff) );           /* Web proxy auto discovery URL */
-                    /* Copy the local IP into the Router & DNS server Options */
-                    memcpy( option_ptr, server_ip_addr_option_buff, 6 );                                                /* Router (gateway)             */
-                    option_ptr[0]  = 3;                                                                                 /* Router id                    */
-                    option_ptr    += 6;
-                    memcpy( option_ptr, server_ip_addr_option_buff, 6 );                                                /* DNS server                   */
-                    option_ptr[0]  = 6;                                                                                 /* DNS server id                */
-                    option_ptr    += 6;
-                    option_ptr     = (char*)MEMCAT( option_ptr, mtu_option_buff, 4 );                                   /* Interface MTU                */
-
-                    /* Create the IP address for the Offer */
-                    temp = htonl(given_ip_address.ip.v4);
-                    memcpy( reply_header->your_ip_addr, &temp, sizeof( temp ) );
-
-                    /* Increment next available IP address only if not found in cache */
-                    if ( next_avail_ip_address_used == true )
-                    {
-                        do
-                        {
-                            next_available_ip_addr = subnet | ( ( next_available_ip_addr + 1 ) & ip_mask );
-                        } while ( next_available_ip_addr == GET_IPV4_ADDRESS(local_ip_address) );
-                    }
-
-                    /* Cache client */
-                    add_client_to_cache( &client_mac_address, &given_ip_address );
-                }
-
-                option_ptr[0] = (char) DHCP_END_OPTION_CODE; /* end options */
-                option_ptr++;
-
-                /* Send reply packet */
-                packet_set_data_end( transmit_packet, (uint8_t*) option_ptr );
-                if (cy_udp_send( &server->socket, &broadcast_addr, IPPORT_DHCPC, transmit_packet ) != CY_RSLT_SUCCESS)
-                {
-                    packet_delete( transmit_packet );
-                }
+                dhcp_lease_arp_addr[ a ] = lease->ip_addr;
             }
             break;
-
-            default:
-                /* Unknown packet type - release received packet */
-                packet_delete( received_packet );
-            break;
         }
     }
-    cy_rtos_exit_thread();
+    DHCP_SERVER_UNLOCK_CORE();
+#else
+    LWIP_UNUSED_ARG( lease );
+#endif /* DHCP_STATIC_ARP_ENTRIES */
 }
 
 /**
- *  Finds a specified DHCP option
- *
- *  Searches the given DHCP request and returns a pointer to the
- *  specified DHCP option data, or NULL if not found
- *
- * @param[out] request    : The DHCP request structure
- * @param[in]  option_num : Which DHCP option number to find
+ *  Removes the static ARP entry of a lease, if it has one
  *
- * @return Pointer to the DHCP option data, or NULL if not found
+ * @param[in] lease : Lease which ended
  */
-static const uint8_t* find_option( const dhcp_header_t* request, uint8_t option_num )
+static void lease_arp_entry_remove( dhcp_lease_t* lease )
 {
-    const uint8_t* option_ptr = request->options;
-    while ( ( option_ptr[0] != DHCP_END_OPTION_CODE ) &&                               /* Check for end-of-options flag */
-            ( option_ptr[0] != option_num ) &&                                         /* Check for matching option number */
-            ( option_ptr < ( (const uint8_t*) request ) + sizeof( dhcp_header_t ) ) )  /* Check for buffer overrun */
+#if DHCP_STATIC_ARP_ENTRIES
+    ip4_addr_t arp_ip_addr;
+    uint32_t   a;
+
+    if ( !lease->arp_entry )
     {
-        option_ptr += option_ptr[1] + 2;
+        return;
     }
 
-    /* Was the option found? */
-    if ( option_ptr[0] == option_num )
+    ip4_addr_set_u32( &arp_ip_addr, htonl( lease->ip_addr ) );
+
+    DHCP_SERVER_LOCK_CORE();
+    etharp_remove_static_entry( &arp_ip_addr );
+    for ( a = 0; a < CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX; a++ )
     {
-        return &option_ptr[2];
+        if ( dhcp_lease_arp_addr[ a ] == lease->ip_addr )
+        {
+            dhcp_lease_arp_addr[ a ] = 0;
+            break;
+        }
     }
-    return NULL;
+    DHCP_SERVER_UNLOCK_CORE();
+    lease->arp_entry = 0;
+#else
+    LWIP_UNUSED_ARG( lease );
+#endif /* DHCP_STATIC_ARP_ENTRIES */
 }
 
 /**
- *  Searches the cache for a given MAC address to find a matching IP address
- *
- * @param[in]  client_mac_address : MAC address to search for
- * @param[out] client_ip_address  : Receives any IP address which is found
+ *  Removes the static ARP entries of the leases which expired. The leases themselves stay until reclaimed.
  *
- * @return true if found, false otherwise
+ * @param[in] server : DHCP server instance
+ * @param[in] now    : Current server time
  */
-static bool get_client_ip_address_from_cache( const cy_lwip_mac_addr_t* client_mac_address, cy_lwip_ip_address_t* client_ip_address )
+static void lease_arp_entries_expire( cy_lwip_dhcp_server_t* server, uint32_t now )
 {
     uint32_t a;
 
-    /* Check whether device is already cached */
-    for ( a = 0; a < DHCP_IP_ADDRESS_CACHE_MAX; a++ )
+    for ( a = 0; a <= server->lease_table_mask; a++ )
     {
-        if ( memcmp( &cached_mac_addresses[ a ], client_mac_address, sizeof( *client_mac_address ) ) == 0 )
+        if ( server->lease_table[ a ].arp_entry && DHCP_LEASE_EXPIRED( &server->lease_table[ a ], now ) )
         {
-            *client_ip_address = cached_ip_addresses[ a ];
-            return true;
+            lease_arp_entry_remove( &server->lease_table[ a ] );
         }
     }
-
-    return false;
 }
 
 /**
- *  Adds the MAC & IP addresses of a client to the cache
+ *  Keeps a declined address out of the pool for DHCP_DECLINE_QUARANTINE_TIME_S
  *
- * @param[in] client_mac_address : MAC address of the client to store
- * @param[in] client_ip_address  : IP address of the client to store
+ *  The address is in use by a host the server does not know of. If all the quarantine slots
+ *  are taken, the address quarantined first is returned to the pool early.
  *
- * @return CY_RSLT_SUCCESS
+ * @param[in] server  : DHCP server instance
+ * @param[in] ip_addr : Declined address, host byte order
+ * @param[in] now     : Current server time
  */
-static cy_rslt_t add_client_to_cache( const cy_lwip_mac_addr_t* client_mac_address, const cy_lwip_ip_address_t* client_ip_address )
+static void quarantine_add( cy_lwip_dhcp_server_t* server, uint32_t ip_addr, uint32_t now )
 {
-    uint32_t a;
-    uint32_t first_empty_slot;
-    uint32_t cached_slot;
+    uint32_t slot = server->quarantine_next;
 
-    /* Search for empty slot in cache */
-    for ( a = 0, first_empty_slot = DHCP_IP_ADDRESS_CACHE_MAX, cached_slot = DHCP_IP_ADDRESS_CACHE_MAX; a < DHCP_IP_ADDRESS_CACHE_MAX; a++ )
+    if ( server->quarantine_addr[ slot ] != 0 )
     {
-        /* Check for matching MAC address */
-        if ( memcmp( &cached_mac_addresses[ a ], client_mac_address, sizeof( *client_mac_address ) ) == 0 )
-        {
-            /* Cached device found */
-            cached_slot = a;
-            break;
-        }
-        else if ( first_empty_slot == DHCP_IP_ADDRESS_CACHE_MAX && memcmp( &cached_mac_addresses[ a ], &empty_cache, sizeof(cy_lwip_mac_addr_t) ) == 0 )
-        {
-            /* Device not found in cache. Return the first empty slot */
-            first_empty_slot = a;
-        }
+        POOL_BIT_CLEAR( server->address_pool, server->quarantine_addr[ slot ] - server->pool_subnet );
     }
 
-    if ( cached_slot != DHCP_IP_ADDRESS_CACHE_MAX )
-    {
-        /* Update IP address of cached device */
-        cached_ip_addresses[cached_slot] = *client_ip_address;
-    }
-    else if ( first_empty_slot != DHCP_IP_ADDRESS_CACHE_MAX )
-    {
-        /* Add device to the first empty slot */
-        cached_mac_addresses[ first_empty_slot ] = *client_mac_address;
-        cached_ip_addresses [ first_empty_slot ] = *client_ip_address;
-    }
-    else
+    POOL_BIT_SET( server->address_pool, ip_addr - server->pool_subnet );
+    server->quarantine_addr [ slot ] = ip_addr;
+    server->quarantine_until[ slot ] = now + DHCP_DECLINE_QUARANTINE_TIME_S;
+    server->quarantine_next = ( slot + 1 ) % DHCP_DECLINE_QUARANTINE_MAX;
+}
+
+/**
+ *  Returns the addresses whose quarantine is over to the pool
+ *
+ * @param[in] server : DHCP server instance
+ * @param[in] now    : Current server time
+ */
+static void quarantine_expire( cy_lwip_dhcp_server_t* server, uint32_t now )
+{
+    uint32_t a;
+
+    for ( a = 0; a < DHCP_DECLINE_QUARANTINE_MAX; a++ )
     {
-        /* Cache is full. Add device to slot 0 */
-        cached_mac_addresses[ 0 ] = *client_mac_address;
-        cached_ip_addresses [ 0 ] = *client_ip_address;
+        if ( ( server->quarantine_addr[ a ] != 0 ) && ( (int32_t) ( now - server->quarantine_until[ a ] ) >= 0 ) )
+        {
+            POOL_BIT_CLEAR( server->address_pool, server->quarantine_addr[ a ] - server->pool_subnet );
+            server->quarantine_addr[ a ] = 0;
+        }
     }
-
-    return CY_RSLT_SUCCESS;
 }
 
 /**
@@ -739,8 +1517,162 @@ static void ipv4_to_string( char buffer[16], uint32_t ipv4_address )
     unsigned_to_decimal_string(ip[3], &buffer[12], 3, 3);
 }
 
+/**
+ *  Reserves the reply buffers of a server
+ *
+ * @param[in] server : DHCP server instance
+ *
+ * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
+ */
+static cy_rslt_t reply_pool_init( cy_lwip_dhcp_server_t* server )
+{
+    dhcp_reply_pool_t* pool;
+    int i;
+
+    pool = (dhcp_reply_pool_t*) calloc( 1, sizeof(dhcp_reply_pool_t) );
+    if ( pool == NULL )
+    {
+        return CY_RSLT_LWIP_DHCP_SERVER_NO_MEMORY;
+    }
+
+    for ( i = 0; i < DHCP_REPLY_BUFFER_COUNT; i++ )
+    {
+        pool->buffers[i].pool                       = pool;
+        pool->buffers[i].pbuf.custom_free_function  = reply_buffer_free;
+    }
+    server->reply_pool = pool;
+
+    return CY_RSLT_SUCCESS;
+}
+
+/**
+ *  Releases the reply buffers of a server. Buffers still held by the stack or the driver are
+ *  released when they come back.
+ *
+ * @param[in] server : DHCP server instance
+ */
+static void reply_pool_deinit( cy_lwip_dhcp_server_t* server )
+{
+    dhcp_reply_pool_t* pool = server->reply_pool;
+    bool               release;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if ( pool == NULL )
+    {
+        return;
+    }
+    server->reply_pool = NULL;
+
+    SYS_ARCH_PROTECT(lev);
+    pool->orphaned = true;
+    release        = ( pool->in_use == 0 );
+    SYS_ARCH_UNPROTECT(lev);
+
+    if ( release )
+    {
+        free( pool );
+    }
+}
+
+/**
+ *  Takes a free reply buffer, with room for the longest reply and for the headers of the lower layers
+ *
+ * @param[in] server : DHCP server instance
+ *
+ * @return The buffer as a pbuf of DHCP_REPLY_MAX_LENGTH bytes, or NULL if all the buffers are in flight
+ */
+static struct pbuf* reply_buffer_alloc( cy_lwip_dhcp_server_t* server )
+{
+    dhcp_reply_pool_t*   pool   = server->reply_pool;
+    dhcp_reply_buffer_t* buffer = NULL;
+    int i;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    for ( i = 0; i < DHCP_REPLY_BUFFER_COUNT; i++ )
+    {
+        if ( pool->buffers[i].in_use == false )
+        {
+            buffer         = &pool->buffers[i];
+            buffer->in_use = true;
+            pool->in_use++;
+            break;
+        }
+    }
+    SYS_ARCH_UNPROTECT(lev);
+
+    if ( buffer == NULL )
+    {
+        return NULL;
+    }
+
+    return pbuf_alloced_custom( PBUF_TRANSPORT, DHCP_REPLY_MAX_LENGTH, PBUF_RAM, &buffer->pbuf, buffer->memory, sizeof(buffer->memory) );
+}
+
+/**
+ *  Returns a reply buffer to its pool, once the stack and the driver are done with it
+ *
+ * @param[in] p : pbuf of the buffer
+ */
+static void reply_buffer_free( struct pbuf* p )
+{
+    dhcp_reply_buffer_t* buffer = (dhcp_reply_buffer_t*) p;
+    dhcp_reply_pool_t*   pool   = buffer->pool;
+    bool                 release;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    buffer->in_use = false;
+    pool->in_use--;
+    release = ( pool->orphaned && ( pool->in_use == 0 ) );
+    SYS_ARCH_UNPROTECT(lev);
+
+    if ( release )
+    {
+        free( pool );
+    }
+}
+
+/**
+ *  Handles a received message and builds the reply in a reply buffer. When all the buffers are in flight, the
+ *  message is still handled, so that a RELEASE or a DECLINE is not lost, and only its reply is dropped.
+ *
+ * @param[in] server         : DHCP server instance
+ * @param[in] request_header : Received message
+ * @param[in] request_length : Length of the received message
+ *
+ * @return The reply, to free once sent, or NULL if there is nothing to send
+ */
+static struct pbuf* dhcp_server_handle( cy_lwip_dhcp_server_t* server, const dhcp_header_t* request_header, uint16_t request_length )
+{
+    struct pbuf* reply;
+    uint16_t     reply_length;
+
+    reply = reply_buffer_alloc( server );
+    if ( reply == NULL )
+    {
+        if ( dhcp_server_process( server, request_header, request_length, (dhcp_header_t*) server->reply_pool->scratch ) != 0 )
+        {
+            server->stats.reply_buffer_exhausted++;
+            wm_cy_log_msg(CYLF_MIDDLEWARE, CY_LOG_DEBUG, "DHCP server: no reply buffer free, reply dropped \n");
+        }
+        return NULL;
+    }
+
+    reply_length = dhcp_server_process( server, request_header, request_length, (dhcp_header_t*) reply->payload );
+    if ( reply_length == 0 )
+    {
+        pbuf_free( reply );
+        return NULL;
+    }
+    pbuf_realloc( reply, reply_length );
+
+    return reply;
+}
+
+#if !CY_LWIP_DHCP_SERVER_RAW_API
 
-static cy_rslt_t udp_create_socket(cy_lwip_udp_socket_t *socket, uint16_t port, cy_lwip_nw_interface_role_t interface)
+static cy_rslt_t udp_create_socket(cy_lwip_udp_socket_t *socket, uint16_t port, struct netif *netif)
 {
     err_t status;
 
@@ -759,16 +1691,22 @@ static cy_rslt_t udp_create_socket(cy_lwip_udp_socket_t *socket, uint16_t port,
     /* Call wifi-mw-core network activity function to resume the network stack. */
     cy_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
 
-    /* Bind it to designated port and IP */
-    status = netconn_bind( socket->conn_handler, IP_ANY_TYPE, port );
+    /* Bind it to designated port and to the address of the interface, so that servers of other interfaces can bind the same port */
+    status = netconn_bind( socket->conn_handler, netif_ip_addr4(netif), port );
     if( status != ERR_OK )
     {
         netconn_delete( socket->conn_handler );
         socket->conn_handler = NULL;
         return CY_RSLT_LWIP_SOCKET_ERROR;
     }
+
+    /* Only receive and send through the interface */
+    LOCK_TCPIP_CORE();
+    udp_bind_netif(socket->conn_handler->pcb.udp, netif);
+    UNLOCK_TCPIP_CORE();
+
     socket->is_bound  = true;
-    socket->role = interface;
+    socket->netif     = netif;
 
     return CY_RSLT_SUCCESS;
 }
@@ -847,31 +1785,30 @@ static cy_rslt_t packet_get_data(cy_lwip_packet_t *packet, uint16_t offset, uint
     return CY_RSLT_LWIP_CORRUPT_BUFFER;
 }
 
-static cy_rslt_t packet_set_data_end(cy_lwip_packet_t *packet, uint8_t* data_end)
-{
-    packet->ptr->len     = (uint16_t) ( data_end - ( (uint8_t*) packet->ptr->payload ) );
-    packet->p->tot_len = packet->p->len;
-
-    return CY_RSLT_SUCCESS;
-}
-
 static cy_rslt_t packet_delete(cy_lwip_packet_t* packet)
 {
     netbuf_delete( packet );
     return CY_RSLT_SUCCESS;
 }
 
-static cy_rslt_t cy_udp_send(cy_lwip_udp_socket_t* socket, const cy_lwip_ip_address_t* address, uint16_t port, cy_lwip_packet_t* packet)
+static cy_rslt_t cy_udp_send(cy_lwip_dhcp_server_t* server, const cy_lwip_ip_address_t* address, uint16_t port, struct pbuf* p)
 {
+    cy_lwip_udp_socket_t *socket = &server->socket;
+    cy_lwip_packet_t packet;
     ip_addr_t temp;
     err_t status;
     cy_rslt_t result;
 
-    if((socket == NULL) || (address == NULL) || (packet == NULL))
+    if((address == NULL) || (p == NULL))
     {
         return CY_RSLT_LWIP_BAD_ARG;
     }
 
+    /* The buffer stays owned by the caller, the netbuf only carries it to the socket */
+    memset(&packet, 0, sizeof(packet));
+    packet.p   = p;
+    packet.ptr = p;
+
     /* Associate UDP socket with specific remote IP address and a port */
     cy_ip_to_lwip(&temp, address);
 
@@ -886,10 +1823,10 @@ static cy_rslt_t cy_udp_send(cy_lwip_udp_socket_t* socket, const cy_lwip_ip_addr
     }
 
     /* Total length and a length must be equal for a packet to be valid */
-    packet->p->len = packet->p->tot_len;
+    p->len = p->tot_len;
 
     /* Send the packet via UDP socket */
-    result = internal_udp_send(socket->conn_handler, packet, (cy_lwip_nw_interface_role_t)socket->role);
+    result = internal_udp_send(server, &packet);
     if ( result != CY_RSLT_SUCCESS )
     {
         /* Call wifi-mw-core network activity function to resume the network stack. */
@@ -899,14 +1836,11 @@ static cy_rslt_t cy_udp_send(cy_lwip_udp_socket_t* socket, const cy_lwip_ip_addr
         return result;
     }
 
-    netbuf_delete( packet );
-
     /* Call wifi-mw-core network activity function to resume the network stack. */
     cy_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
 
     /* Return back to disconnected state
-     * Note: We are ignoring the return for this as we MUST return CY_RSLT_SUCCESS otherwise the caller may attempt to
-     * free the packet a second time.
+     * Note: We are ignoring the return for this as the packet was sent.
      */
     netconn_disconnect(socket->conn_handler);
     return CY_RSLT_SUCCESS;
@@ -920,10 +1854,10 @@ void cy_ip_to_lwip(ip_addr_t *dest, const cy_lwip_ip_address_t *src)
     }
 }
 
-static cy_rslt_t internal_udp_send(struct netconn* handler, cy_lwip_packet_t* packet, cy_lwip_nw_interface_role_t interface)
+static cy_rslt_t internal_udp_send(cy_lwip_dhcp_server_t* server, cy_lwip_packet_t* packet)
 {
     err_t status;
-    if(cy_rtos_get_mutex(&dhcp_mutex, CY_DHCP_MAX_MUTEX_WAIT_TIME_MS) != CY_RSLT_SUCCESS)
+    if(cy_rtos_get_mutex(&server->mutex, CY_DHCP_MAX_MUTEX_WAIT_TIME_MS) != CY_RSLT_SUCCESS)
     {
         return CY_RSLT_LWIP_DHCP_WAIT_TIMEOUT;
     }
@@ -931,48 +1865,14 @@ static cy_rslt_t internal_udp_send(struct netconn* handler, cy_lwip_packet_t* pa
     /* Call wifi-mw-core network activity function to resume the network stack. */
     cy_network_activity_notify(CY_NETWORK_ACTIVITY_TX);
 
-    /* Bind interface to the socket. */
-    udp_bind_netif(handler->pcb.udp, cy_lwip_get_interface(interface));
-
     /* send a packet */
     packet->p->len = packet->p->tot_len;
-    status = netconn_send( handler, packet );
-    if (cy_rtos_set_mutex(&dhcp_mutex) != CY_RSLT_SUCCESS)
+    status = netconn_send( server->socket.conn_handler, packet );
+    if (cy_rtos_set_mutex(&server->mutex) != CY_RSLT_SUCCESS)
     {
         return CY_RSLT_LWIP_DHCP_MUTEX_ERROR;
     }
-    netbuf_free(packet);
     return ((status == CY_RSLT_SUCCESS) ? CY_RSLT_SUCCESS : CY_RSLT_LWIP_SOCKET_ERROR);
 }
-
-static cy_rslt_t packet_create_udp(cy_lwip_packet_t** packet, uint8_t** data, uint16_t* available_space )
-{
-    return internal_packet_create(packet, MAX_UDP_PAYLOAD_SIZE, data, available_space);
-}
-
-static cy_rslt_t internal_packet_create( cy_lwip_packet_t** packet, uint16_t content_length, uint8_t** data, uint16_t* available_space )
-{
-    int i = 0;
-
-    for (i = 0; i < ALLOCATE_PACKET_TIMEOUT; ++i)
-    {
-        *packet = netbuf_new();
-        if (*packet != NULL)
-        {
-            *data = netbuf_alloc(*packet, content_length);
-            if (*data != NULL)
-            {
-                *available_space = content_length;
-                return CY_RSLT_SUCCESS;
-            }
-            netbuf_delete(*packet);
-            *packet = NULL;
-            *available_space = 0;
-        }
-        cy_rtos_delay_milliseconds(1);
-    }
-
-    *available_space = 0;
-    return CY_RSLT_LWIP_DHCP_TIMEOUT;
-}
+#endif /* !CY_LWIP_DHCP_SERVER_RAW_API */
 #endif //LWIP_IPV4
@@ -59,6 +59,44 @@ extern "C" {
 #define ALWAYS_INLINE
 #endif
 
+/**
+ * Set to 1 to run the DHCP server in the TCP/IP thread on a raw UDP PCB, instead of a dedicated thread on a netconn
+ */
+#ifndef CY_LWIP_DHCP_SERVER_RAW_API
+#define CY_LWIP_DHCP_SERVER_RAW_API            (0)
+#endif
+
+/**
+ * Number of clients a DHCP server holds a lease for at once, unless set by max_leases in @ref cy_lwip_dhcp_server_config_t.
+ * The lease table is allocated at server start and takes 48 to 96 bytes per lease: each lease has at least two
+ * slots of 24 bytes, and the number of slots is rounded up to a power of two.
+ */
+#ifndef CY_LWIP_DHCP_SERVER_MAX_LEASES
+#define CY_LWIP_DHCP_SERVER_MAX_LEASES         (64)
+#endif
+
+/**
+ * Number of static ARP entries the DHCP servers add for their leases when static_arp is set in
+ * @ref cy_lwip_dhcp_server_config_t, across all the servers. Static entries are never evicted from the ARP table,
+ * which is shared with the other interfaces, so the limit must leave at least 4 of the ARP_TABLE_SIZE entries free.
+ * The clients beyond the limit are resolved by ARP as usual.
+ */
+#ifndef CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX
+#define CY_LWIP_DHCP_SERVER_STATIC_ARP_MAX     (ARP_TABLE_SIZE / 2)
+#endif
+
+/**
+ * Number of addresses declined by clients which a DHCP server keeps out of its pool at the same time
+ */
+#ifndef DHCP_DECLINE_QUARANTINE_MAX
+#define DHCP_DECLINE_QUARANTINE_MAX            (4)
+#endif
+
+/**
+ * Length of the options common to all the OFFER and ACK replies of a DHCP server
+ */
+#define CY_LWIP_DHCP_REPLY_TEMPLATE_LENGTH     (68)
+
 #ifndef htobe32   /* This is defined in POSIX platforms */
 ALWAYS_INLINE_PRE static inline ALWAYS_INLINE uint32_t htobe32(uint32_t v)
 {
@@ -117,15 +155,51 @@ struct cy_lwip_udp_socket_struct
     struct netconn                *conn_handler;
     ip_addr_t                     local_ip_addr;
     bool                          is_bound;
-    cy_lwip_nw_interface_role_t   role;
+    struct netif                  *netif;
 };
 
+/**
+ * DHCP server instance. The state of each instance is kept here, so that servers can run on several interfaces at once.
+ * The structure is zeroed by the caller before the first start.
+ */
 typedef struct
 {
+#if CY_LWIP_DHCP_SERVER_RAW_API
+    struct udp_pcb               *pcb;
+#else
     cy_thread_t                  thread;
     cy_lwip_udp_socket_t         socket;
+    cy_mutex_t                   mutex;
     volatile bool                quit;
+#endif
     cy_lwip_nw_interface_role_t  role;
+    cy_lwip_dhcp_server_config_t config;   /* Set by the caller before cy_lwip_dhcp_server_start */
+    struct netif                 *netif;   /* Interface served. Set by the caller before cy_lwip_dhcp_server_start, or NULL for the first interface of the role */
+    cy_lwip_dhcp_server_stats_t  stats;
+    bool                         started;  /* false in a zeroed structure */
+
+    /* Leases and address pool */
+    struct cy_lwip_dhcp_lease    *lease_table;       /* open-addressed on the client MAC address */
+    uint32_t                     lease_table_mask;   /* number of slots minus one */
+    uint32_t                     lease_count;
+    uint32_t                     lease_max;
+    uint32_t                     *address_pool;      /* bitmap of the host numbers in use */
+    uint32_t                     pool_subnet;
+    uint32_t                     pool_size;          /* host numbers 1 to pool_size are served */
+    uint32_t                     pool_next_host;
+    uint32_t                     quarantine_addr [DHCP_DECLINE_QUARANTINE_MAX];  /* declined addresses, 0 if unused */
+    uint32_t                     quarantine_until[DHCP_DECLINE_QUARANTINE_MAX];
+    uint32_t                     quarantine_next;
+
+    /* Server time, in seconds since the start */
+    cy_time_t                    server_time_ms;
+    uint32_t                     server_time_s;
+    uint32_t                     server_time_rem_ms;
+
+    /* Replies */
+    uint32_t                     local_ip_addr;      /* host byte order */
+    uint8_t                      reply_template[CY_LWIP_DHCP_REPLY_TEMPLATE_LENGTH];  /* options of the OFFER and ACK replies */
+    struct cy_lwip_dhcp_reply_pool *reply_pool;      /* buffers reserved at start, so that replying never waits for memory */
 } cy_lwip_dhcp_server_t;
 
 /******************************************************
@@ -150,7 +224,10 @@ typedef struct
  *  Start a DHCP server instance.
  *
  * @param[in] server      Structure that will be used for this DHCP server instance allocated by caller, @ref cy_lwip_dhcp_server_t.
- * @param[in] iface_type  Which network interface the DHCP server should listen on.
+ *                        The caller zeroes the structure before the first start, then sets its config and netif fields.
+ *                        The rest is initialized by this function. Starting a server which is already started does nothing,
+ *                        and a stopped server can be started again without zeroing the structure.
+ * @param[in] iface_type  Role of the network interface the DHCP server should listen on, used when netif is NULL.
  *
  * @return CY_RSLT_SUCCESS if successful, failure code otherwise.
  */
@@ -158,7 +235,8 @@ cy_rslt_t cy_lwip_dhcp_server_start(cy_lwip_dhcp_server_t *server, cy_lwip_nw_in
 
 
 /**
- *  Stop a DHCP server instance.
+ *  Stop a DHCP server instance. Unless CY_LWIP_DHCP_SERVER_RAW_API is enabled, this waits for the server thread
+ *  to exit, which takes up to half a second.
  *
  * @param[in] server     Structure workspace for the DHCP server instance - as used with @ref cy_lwip_dhcp_server_t.
  *
@@ -166,6 +244,16 @@ cy_rslt_t cy_lwip_dhcp_server_start(cy_lwip_dhcp_server_t *server, cy_lwip_nw_in
  */
 cy_rslt_t cy_lwip_dhcp_server_stop(cy_lwip_dhcp_server_t *server);
 
+/**
+ *  Checks whether the ARP entry of an address is a static entry added by a DHCP server for a lease.
+ *  LwIP never updates such entries from ARP replies. Must be called with the TCP/IP core lock held.
+ *
+ * @param[in] ip_addr    IPv4 address to check.
+ *
+ * @return true if a DHCP server added a static ARP entry for the address, false otherwise.
+ */
+bool cy_lwip_dhcp_server_is_lease_arp_entry(const ip4_addr_t *ip_addr);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
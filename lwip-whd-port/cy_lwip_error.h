@@ -94,6 +94,19 @@ extern "C" {
 #define CY_RSLT_LWIP_ERROR_STARTING_INTERNAL_DHCP          (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 14) /**< Denotes failure to start internal DHCP server */
 #define CY_RSLT_LWIP_INTERFACE_NETWORK_NOT_UP                   (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 15) /**< Denotes network is not up for the given interface */
 #define CY_RSLT_LWIP_ERROR_REMOVING_INTERFACE              (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 16) /**< Denotes error while removing interface */
+#define CY_RSLT_LWIP_ETHERTYPE_HANDLER_TABLE_FULL          (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 17) /**< Denotes ethertype handler table is full */
+#define CY_RSLT_LWIP_ETHERTYPE_HANDLER_NOT_FOUND           (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 18) /**< Denotes no handler is registered for the ethertype */
+#define CY_RSLT_LWIP_TX_SCHEDULER_DISABLED                 (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 19) /**< Denotes the TX scheduler is not compiled in (CY_LWIP_TX_SCHEDULER) */
+#define CY_RSLT_LWIP_NETWORK_UP_IN_PROGRESS                (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 20) /**< Denotes a network bring up is already in progress on the interface */
+#define CY_RSLT_LWIP_NETWORK_UP_ABORTED                    (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 21) /**< Denotes the network bring up was aborted by cy_lwip_network_down */
+#define CY_RSLT_LWIP_DHCP_LEASE_CACHE_DISABLED             (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 22) /**< Denotes the DHCP lease cache is not compiled in (CY_LWIP_DHCP_LEASE_CACHE_SIZE) */
+#define CY_RSLT_LWIP_PHASE_TIMING_DISABLED                 (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 23) /**< Denotes phase timing is not compiled in (CY_LWIP_PHASE_TIMING) */
+#define CY_RSLT_LWIP_IP_CHANGE_SUBSCRIBER_TABLE_FULL       (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 24) /**< Denotes the IP change subscriber table is full */
+#define CY_RSLT_LWIP_DHCP_RENEW_IN_PROGRESS                (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 25) /**< Denotes a DHCP renewal is already in progress on the interface */
+#define CY_RSLT_LWIP_DHCP_RENEW_ABORTED                    (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 26) /**< Denotes the DHCP renewal was aborted by cy_lwip_network_down */
+#define CY_RSLT_LWIP_DHCP_SERVER_NO_MEMORY                 (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 27) /**< Denotes the DHCP server could not allocate its lease table */
+#define CY_RSLT_LWIP_DHCP_RENEW_FAILED                     (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 28) /**< Denotes the DHCP renewal request could not be sent */
+#define CY_RSLT_LWIP_RX_FILTER_MUTEX_ERROR                 (CY_RSLT_LWIP_WHD_PORT_ERR_BASE + 29) /**< Denotes the RX filter mutex could not be created or taken */
 /**
  * \}
  */
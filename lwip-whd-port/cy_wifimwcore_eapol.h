@@ -68,7 +68,9 @@ typedef void (*cy_wifimwcore_eapol_packet_handler_t) (whd_interface_t whd_iface,
  * This API allows registering callback functions to receive EAPOL packets
  * from WHD. If callback is registered and received packet is EAPOL packet
  * then it will be directly redirected to registered callback. passing "NULL"
- * as handler will de-register the previously registered callback
+ * as handler will de-register the previously registered callback.
+ * The handler applies to both STA and AP interfaces and is registered through
+ * \ref cy_lwip_register_ethertype_handler.
  *
  * @param[in] eapol_packet_handler : Callback function to be invoked when eapol packets are recieved from WHD.
  *